@@ -0,0 +1,480 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sway/config.h"
+#include "sway/input_state.h"
+#include "sway.h"
+#include "list.h"
+#include "stringop.h"
+
+/*
+ * The linear key_state array sway used before the bitmap and key sym table,
+ * kept here as the baseline to compare against.
+ */
+#define KEY_STATE_MAX_LENGTH 64
+
+struct linear_key_state {
+	uint32_t key_sym;
+	uint32_t alt_sym;
+	uint32_t key_code;
+};
+
+static struct linear_key_state linear_keys[KEY_STATE_MAX_LENGTH];
+static struct linear_key_state linear_last_released;
+
+static void linear_reset(void) {
+	memset(linear_keys, 0, sizeof(linear_keys));
+	memset(&linear_last_released, 0, sizeof(linear_last_released));
+}
+
+static uint8_t linear_find_key(uint32_t key_sym, uint32_t key_code, bool update) {
+	int i;
+	for (i = 0; i < KEY_STATE_MAX_LENGTH; ++i) {
+		if (0 == key_sym && 0 == key_code && linear_keys[i].key_sym == 0) {
+			break;
+		}
+		if (key_sym != 0 && (linear_keys[i].key_sym == key_sym
+			|| linear_keys[i].alt_sym == key_sym)) {
+			break;
+		}
+		if (update && linear_keys[i].key_code == key_code) {
+			linear_keys[i].alt_sym = key_sym;
+			break;
+		}
+		if (key_sym == 0 && key_code != 0 && linear_keys[i].key_code == key_code) {
+			break;
+		}
+	}
+	return i;
+}
+
+static bool linear_check_key(uint32_t key_sym, uint32_t key_code) {
+	return linear_find_key(key_sym, key_code, false) < KEY_STATE_MAX_LENGTH;
+}
+
+static void linear_press_key(uint32_t key_sym, uint32_t key_code) {
+	if (key_code == 0) {
+		return;
+	}
+	if (!linear_check_key(key_sym, key_code)) {
+		int insert = linear_find_key(0, 0, true);
+		if (insert < KEY_STATE_MAX_LENGTH) {
+			linear_keys[insert].key_sym = key_sym;
+			linear_keys[insert].key_code = key_code;
+		}
+	}
+}
+
+static void linear_release_key(uint32_t key_sym, uint32_t key_code) {
+	uint8_t index = linear_find_key(key_sym, key_code, true);
+	if (index < KEY_STATE_MAX_LENGTH) {
+		linear_last_released = linear_keys[index];
+		struct linear_key_state none = { 0, 0, 0 };
+		linear_keys[index] = none;
+	}
+}
+
+static bool linear_check_released_key(uint32_t key_sym) {
+	return key_sym != 0 && (linear_last_released.key_sym == key_sym
+		|| linear_last_released.alt_sym == key_sym);
+}
+
+/*
+ * The behaviour key_state.c implements, spelled out as a plain list of held
+ * keys. The linear array above loses keys whose syms alias and misreports
+ * the alt sym, so binding matches are checked against this one instead.
+ */
+static struct {
+	uint32_t key_sym, key_code;
+} held_keys[KEY_STATE_MAX_LENGTH];
+static int held_count;
+static struct linear_key_state held_last_released;
+
+static void held_reset(void) {
+	held_count = 0;
+	memset(&held_last_released, 0, sizeof(held_last_released));
+}
+
+static int held_find_code(uint32_t key_code) {
+	for (int i = 0; i < held_count; ++i) {
+		if (held_keys[i].key_code == key_code) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static bool held_check_key(uint32_t key_sym, uint32_t key_code) {
+	if (key_sym == 0) {
+		return held_find_code(key_code) != -1;
+	}
+	for (int i = 0; i < held_count; ++i) {
+		if (held_keys[i].key_sym == key_sym) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void held_press_key(uint32_t key_sym, uint32_t key_code) {
+	if (key_code == 0 || held_find_code(key_code) != -1
+			|| held_count == KEY_STATE_MAX_LENGTH) {
+		return;
+	}
+	held_keys[held_count].key_sym = key_sym;
+	held_keys[held_count].key_code = key_code;
+	held_count++;
+}
+
+static void held_release_key(uint32_t key_sym, uint32_t key_code) {
+	int i = held_find_code(key_code);
+	if (i == -1) {
+		return;
+	}
+	held_last_released.key_code = key_code;
+	held_last_released.key_sym = held_keys[i].key_sym;
+	held_last_released.alt_sym = key_sym != held_keys[i].key_sym ? key_sym : 0;
+	held_keys[i] = held_keys[--held_count];
+}
+
+static bool held_check_released_key(uint32_t key_sym) {
+	return key_sym != 0 && (held_last_released.key_sym == key_sym
+		|| held_last_released.alt_sym == key_sym);
+}
+
+struct key_ops {
+	const char *name;
+	void (*reset)(void);
+	void (*press)(uint32_t key_sym, uint32_t key_code);
+	void (*release)(uint32_t key_sym, uint32_t key_code);
+	bool (*check)(uint32_t key_sym, uint32_t key_code);
+	bool (*check_released)(uint32_t key_sym);
+};
+
+// Bindings are checked against the held keys on every key event
+#define CHECKS_PER_EVENT 16
+#define MAX_HELD 6
+
+struct key_event {
+	bool press;
+	uint32_t key_sym, key_code;
+	uint32_t modifiers;
+};
+
+enum stream_kind {
+	// one key sym per key code, the same on press and release
+	STREAM_UNIQUE,
+	// key codes share key syms, some keys are released with another sym
+	// than they were pressed with and modifiers change along the way
+	STREAM_ALIASED,
+};
+
+static uint32_t press_sym(enum stream_kind kind, uint32_t code) {
+	return kind == STREAM_UNIQUE ? 0x61 + code : XKB_KEY_a + code % 26;
+}
+
+static uint32_t release_sym(enum stream_kind kind, uint32_t code) {
+	if (kind == STREAM_ALIASED && rand() % 4 == 0) {
+		// e.g. the layout was switched while the key was held
+		return XKB_KEY_a + (code * 7 + 3) % 26;
+	}
+	return press_sym(kind, code);
+}
+
+static uint32_t next_modifiers(enum stream_kind kind, uint32_t modifiers) {
+	static const uint32_t states[] = {
+		0, WLC_BIT_MOD_LOGO, WLC_BIT_MOD_LOGO | WLC_BIT_MOD_SHIFT,
+	};
+	if (kind == STREAM_UNIQUE || rand() % 8) {
+		return modifiers;
+	}
+	return states[rand() % 3];
+}
+
+/**
+ * Generates a typing-like stream of at least count presses and releases,
+ * with up to MAX_HELD keys held at once. Every key is released at the end.
+ */
+static struct key_event *generate_events(enum stream_kind kind, int count, int *total) {
+	struct key_event *events = malloc(sizeof(struct key_event) * (count + MAX_HELD));
+	uint32_t held[MAX_HELD];
+	uint32_t modifiers = 0;
+	int nheld = 0, n = 0;
+	srand(1);
+	while (n < count) {
+		modifiers = next_modifiers(kind, modifiers);
+		if (nheld < MAX_HELD && (nheld == 0 || rand() % 2)) {
+			uint32_t code = 8 + rand() % 120;
+			bool is_held = false;
+			for (int i = 0; i < nheld; ++i) {
+				is_held |= held[i] == code;
+			}
+			if (is_held) {
+				continue;
+			}
+			held[nheld++] = code;
+			events[n++] = (struct key_event){ true, press_sym(kind, code), code, modifiers };
+		} else {
+			int i = rand() % nheld;
+			uint32_t code = held[i];
+			held[i] = held[--nheld];
+			events[n++] = (struct key_event){ false, release_sym(kind, code), code, modifiers };
+		}
+	}
+	while (nheld) {
+		uint32_t code = held[--nheld];
+		events[n++] = (struct key_event){ false, release_sym(kind, code), code, modifiers };
+	}
+	*total = n;
+	return events;
+}
+
+static double run(const struct key_ops *ops, const struct key_event *events,
+		int count, int iterations, unsigned long *hits) {
+	struct timespec start, end;
+	ops->reset();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int it = 0; it < iterations; ++it) {
+		for (int i = 0; i < count; ++i) {
+			const struct key_event *ev = &events[i];
+			if (ev->press) {
+				ops->press(ev->key_sym, ev->key_code);
+			} else {
+				ops->release(ev->key_sym, ev->key_code);
+			}
+			for (int j = 0; j < CHECKS_PER_EVENT; ++j) {
+				uint32_t code = 8 + (ev->key_code + j * 7) % 120;
+				*hits += ops->check(j % 2 ? 0x61 + code : 0, code);
+			}
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static void add_binding(struct sway_mode *mode, uint32_t modifiers, bool release,
+		int nkeys, const uint32_t *keys) {
+	struct sway_binding *binding = calloc(1, sizeof(struct sway_binding));
+	binding->order = mode->bindings->length;
+	binding->release = release;
+	binding->modifiers = modifiers;
+	binding->command = strdup("nop");
+	binding->keys = create_list();
+	for (int i = 0; i < nkeys; ++i) {
+		xkb_keysym_t *key = malloc(sizeof(xkb_keysym_t));
+		*key = keys[i];
+		list_add(binding->keys, key);
+	}
+	list_add(mode->bindings, binding);
+}
+
+/**
+ * A mode shaped like a typical config: a binding per letter with and
+ * without shift, some two key combinations and a few release bindings.
+ */
+static struct sway_mode *create_mode(void) {
+	struct sway_mode *mode = calloc(1, sizeof(struct sway_mode));
+	mode->name = strdup("default");
+	mode->bindings = create_list();
+	for (uint32_t i = 0; i < 26; ++i) {
+		uint32_t keys[] = { XKB_KEY_a + i, XKB_KEY_a + (i + 1) % 26 };
+		add_binding(mode, WLC_BIT_MOD_LOGO, false, 1, keys);
+		add_binding(mode, WLC_BIT_MOD_LOGO | WLC_BIT_MOD_SHIFT, false, 1, keys);
+		add_binding(mode, WLC_BIT_MOD_LOGO, false, 2, keys);
+		if (i % 3 == 0) {
+			add_binding(mode, 0, true, 1, keys);
+			add_binding(mode, WLC_BIT_MOD_LOGO, true, 1, keys);
+		}
+	}
+	list_qsort(mode->bindings, sway_binding_cmp_qsort);
+	build_binding_index(mode);
+	return mode;
+}
+
+static void free_mode(struct sway_mode *mode) {
+	free_binding_index(mode);
+	for (int i = 0; i < mode->bindings->length; ++i) {
+		struct sway_binding *binding = mode->bindings->items[i];
+		free_flat_list(binding->keys);
+		free(binding->command);
+		free(binding);
+	}
+	list_free(mode->bindings);
+	free(mode->name);
+	free(mode);
+}
+
+/*
+ * Resolves key events to bindings the way handle_key did before the binding
+ * index: every binding of the mode is tested against the held keys.
+ */
+static struct sway_binding *scan_press_binding(const struct key_ops *keys,
+		struct sway_mode *mode, uint32_t modifiers, uint32_t key_sym) {
+	for (int i = 0; i < mode->bindings->length; ++i) {
+		struct sway_binding *binding = mode->bindings->items[i];
+		if (binding->release || binding->modifiers != modifiers) {
+			continue;
+		}
+		bool valid = true, pressed = false;
+		for (int j = 0; valid && j < binding->keys->length; ++j) {
+			xkb_keysym_t *key = binding->keys->items[j];
+			valid = keys->check(*key, 0);
+			pressed |= *key == key_sym;
+		}
+		if (valid && pressed) {
+			return binding;
+		}
+	}
+	return NULL;
+}
+
+static struct sway_binding *scan_release_binding(const struct key_ops *keys,
+		struct sway_mode *mode, uint32_t modifiers) {
+	for (int i = 0; i < mode->bindings->length; ++i) {
+		struct sway_binding *binding = mode->bindings->items[i];
+		if (!binding->release || binding->modifiers != modifiers
+				|| binding->keys->length != 1) {
+			continue;
+		}
+		if (keys->check_released(*(xkb_keysym_t *)binding->keys->items[0])) {
+			return binding;
+		}
+	}
+	return NULL;
+}
+
+struct matcher {
+	const char *name;
+	const struct key_ops *keys;
+	// resolve through the binding index instead of scanning the bindings
+	bool indexed;
+};
+
+static double run_bindings(const struct matcher *matcher, struct sway_mode *mode,
+		const struct key_event *events, int count, int iterations,
+		struct sway_binding **matched) {
+	const struct key_ops *keys = matcher->keys;
+	struct timespec start, end;
+	keys->reset();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int it = 0; it < iterations; ++it) {
+		for (int i = 0; i < count; ++i) {
+			const struct key_event *ev = &events[i];
+			struct sway_binding *binding;
+			if (ev->press) {
+				keys->press(ev->key_sym, ev->key_code);
+				binding = matcher->indexed
+					? find_press_binding(mode, ev->modifiers, ev->key_sym, ev->key_code)
+					: scan_press_binding(keys, mode, ev->modifiers, ev->key_sym);
+			} else {
+				keys->release(ev->key_sym, ev->key_code);
+				binding = matcher->indexed
+					? find_release_binding(mode, ev->modifiers)
+					: scan_release_binding(keys, mode, ev->modifiers);
+			}
+			matched[i] = binding;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static int bench_keys(int iterations) {
+	int total;
+	struct key_event *events = generate_events(STREAM_UNIQUE, 10000, &total);
+
+	const struct key_ops ops[] = {
+		{ "linear array", linear_reset, linear_press_key, linear_release_key,
+			linear_check_key, linear_check_released_key },
+		{ "bitmap + sym table", input_init, press_key, release_key,
+			check_key, check_released_key },
+	};
+	unsigned long expected = 0;
+	for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+		unsigned long hits = 0;
+		double ns = run(&ops[i], events, total, iterations, &hits);
+		long events_run = (long)total * iterations;
+		printf("%-24s %8.1f ns/event %8.2f ns/lookup\n", ops[i].name,
+				ns / events_run, ns / (events_run * (CHECKS_PER_EVENT + 1)));
+		if (i == 0) {
+			expected = hits;
+		} else if (hits != expected) {
+			fprintf(stderr, "%s disagrees with the baseline: %lu vs %lu hits\n",
+					ops[i].name, hits, expected);
+			free(events);
+			return 1;
+		}
+	}
+	free(events);
+	return 0;
+}
+
+static int bench_bindings(int iterations) {
+	int total;
+	struct key_event *events = generate_events(STREAM_ALIASED, 10000, &total);
+	struct sway_mode *mode = create_mode();
+
+	const struct key_ops linear = { "linear array", linear_reset, linear_press_key,
+		linear_release_key, linear_check_key, linear_check_released_key };
+	const struct key_ops held = { "held list", held_reset, held_press_key,
+		held_release_key, held_check_key, held_check_released_key };
+	const struct key_ops bitmap = { "bitmap + sym table", input_init, press_key,
+		release_key, check_key, check_released_key };
+	const struct matcher matchers[] = {
+		{ "linear array + scan", &linear, false },
+		{ "held list + scan", &held, false },
+		{ "bitmap + index", &bitmap, true },
+	};
+	size_t nmatchers = sizeof(matchers) / sizeof(matchers[0]);
+
+	struct sway_binding **matched[nmatchers];
+	int ret = 0;
+	for (size_t i = 0; i < nmatchers; ++i) {
+		matched[i] = calloc(total, sizeof(struct sway_binding *));
+		double ns = run_bindings(&matchers[i], mode, events, total, iterations, matched[i]);
+		int hits = 0;
+		for (int j = 0; j < total; ++j) {
+			hits += matched[i][j] != NULL;
+		}
+		printf("%-24s %8.1f ns/event %8d bindings matched\n", matchers[i].name,
+				ns / ((long)total * iterations), hits);
+	}
+	// the held list scan is the reference, the old linear array is expected
+	// to miss keys whose syms alias
+	for (int j = 0; j < total; ++j) {
+		if (matched[2][j] != matched[1][j]) {
+			fprintf(stderr, "%s disagrees with %s at event %d\n",
+					matchers[2].name, matchers[1].name, j);
+			ret = 1;
+			break;
+		}
+	}
+	for (size_t i = 0; i < nmatchers; ++i) {
+		free(matched[i]);
+	}
+	free_mode(mode);
+	free(events);
+	return ret;
+}
+
+void sway_terminate(int exit_code) {
+	exit(exit_code);
+}
+
+int main(int argc, char **argv) {
+	int iterations = argc > 1 ? atoi(argv[1]) : 1000;
+	if (iterations <= 0) {
+		fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+		return 1;
+	}
+	printf("Key lookups, one key sym per key code:\n");
+	if (bench_keys(iterations)) {
+		return 1;
+	}
+	printf("Binding matches, aliased key syms and changed release syms:\n");
+	return bench_bindings(iterations);
+}
@@ -0,0 +1,186 @@
+#include "hash.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define HASH_INITIAL_SIZE 16
+
+hash_t *create_hash(unsigned int (*hash)(const void *key),
+		int (*compare)(const void *a, const void *b)) {
+	hash_t *table = malloc(sizeof(hash_t));
+	if (!table) {
+		return NULL;
+	}
+	table->size = HASH_INITIAL_SIZE;
+	table->length = 0;
+	table->buckets = calloc(table->size, sizeof(struct hash_entry *));
+	if (!table->buckets) {
+		free(table);
+		return NULL;
+	}
+	table->hash = hash;
+	table->compare = compare;
+	return table;
+}
+
+void hash_clear(hash_t *hash) {
+	for (int i = 0; i < hash->size; ++i) {
+		struct hash_entry *entry = hash->buckets[i];
+		while (entry) {
+			struct hash_entry *next = entry->next;
+			free(entry);
+			entry = next;
+		}
+		hash->buckets[i] = NULL;
+	}
+	hash->length = 0;
+}
+
+void hash_free(hash_t *hash) {
+	if (hash == NULL) {
+		return;
+	}
+	hash_clear(hash);
+	free(hash->buckets);
+	free(hash);
+}
+
+static struct hash_entry **hash_find(hash_t *hash, const void *key, unsigned int h) {
+	struct hash_entry **entry = &hash->buckets[h & (hash->size - 1)];
+	while (*entry) {
+		if ((*entry)->hash == h && hash->compare((*entry)->key, key) == 0) {
+			break;
+		}
+		entry = &(*entry)->next;
+	}
+	return entry;
+}
+
+static void hash_resize(hash_t *hash) {
+	if (hash->length < hash->size) {
+		return;
+	}
+	int size = hash->size * 2;
+	struct hash_entry **buckets = calloc(size, sizeof(struct hash_entry *));
+	if (!buckets) {
+		// Keep the current table, lookups just get slower
+		return;
+	}
+	for (int i = 0; i < hash->size; ++i) {
+		struct hash_entry *entry = hash->buckets[i];
+		while (entry) {
+			struct hash_entry *next = entry->next;
+			entry->next = buckets[entry->hash & (size - 1)];
+			buckets[entry->hash & (size - 1)] = entry;
+			entry = next;
+		}
+	}
+	free(hash->buckets);
+	hash->buckets = buckets;
+	hash->size = size;
+}
+
+void *hash_get(hash_t *hash, const void *key) {
+	struct hash_entry *entry = *hash_find(hash, key, hash->hash(key));
+	return entry ? entry->value : NULL;
+}
+
+bool hash_contains(hash_t *hash, const void *key) {
+	return *hash_find(hash, key, hash->hash(key)) != NULL;
+}
+
+void *hash_set(hash_t *hash, const void *key, void *value) {
+	unsigned int h = hash->hash(key);
+	struct hash_entry **slot = hash_find(hash, key, h);
+	if (*slot) {
+		void *old = (*slot)->value;
+		(*slot)->key = key;
+		(*slot)->value = value;
+		return old;
+	}
+	struct hash_entry *entry = malloc(sizeof(struct hash_entry));
+	if (!entry) {
+		return NULL;
+	}
+	entry->key = key;
+	entry->value = value;
+	entry->hash = h;
+	entry->next = NULL;
+	*slot = entry;
+	hash->length++;
+	hash_resize(hash);
+	return NULL;
+}
+
+void *hash_del(hash_t *hash, const void *key) {
+	struct hash_entry **slot = hash_find(hash, key, hash->hash(key));
+	struct hash_entry *entry = *slot;
+	if (!entry) {
+		return NULL;
+	}
+	void *value = entry->value;
+	*slot = entry->next;
+	free(entry);
+	hash->length--;
+	return value;
+}
+
+void hash_foreach(hash_t *hash, void (*callback)(const void *key, void *value, void *data), void *data) {
+	if (hash == NULL || callback == NULL) {
+		return;
+	}
+	for (int i = 0; i < hash->size; ++i) {
+		struct hash_entry *entry = hash->buckets[i];
+		while (entry) {
+			// allow the callback to free the entry's key and value
+			struct hash_entry *next = entry->next;
+			callback(entry->key, entry->value, data);
+			entry = next;
+		}
+	}
+}
+
+unsigned int hash_int(unsigned int value) {
+	value ^= value >> 16;
+	value *= 0x7feb352dU;
+	value ^= value >> 15;
+	value *= 0x846ca68bU;
+	value ^= value >> 16;
+	return value;
+}
+
+unsigned int hash_string(const void *key) {
+	// FNV-1a
+	unsigned int h = 2166136261U;
+	for (const unsigned char *c = key; *c; ++c) {
+		h = (h ^ *c) * 16777619U;
+	}
+	return h;
+}
+
+unsigned int hash_string_nocase(const void *key) {
+	unsigned int h = 2166136261U;
+	for (const unsigned char *c = key; *c; ++c) {
+		h = (h ^ tolower(*c)) * 16777619U;
+	}
+	return h;
+}
+
+int hash_string_cmp(const void *a, const void *b) {
+	return strcmp(a, b);
+}
+
+int hash_string_casecmp(const void *a, const void *b) {
+	return strcasecmp(a, b);
+}
+
+unsigned int hash_pointer(const void *key) {
+	uint64_t p = (uintptr_t)key;
+	return hash_int((unsigned int)(p ^ (p >> 32)));
+}
+
+int hash_pointer_cmp(const void *a, const void *b) {
+	return a != b;
+}
@@ -0,0 +1,60 @@
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "hash.h"
+#include "log.h"
+
+struct interned_string {
+	char *str;
+	int refs;
+};
+
+static hash_t *interned_strings = NULL;
+
+char *intern_string(const char *str) {
+	if (!interned_strings) {
+		interned_strings = create_hash(hash_string, hash_string_cmp);
+		if (!interned_strings) {
+			return NULL;
+		}
+	}
+	struct interned_string *interned = hash_get(interned_strings, str);
+	if (!interned) {
+		interned = malloc(sizeof(struct interned_string));
+		if (!interned) {
+			return NULL;
+		}
+		if (!(interned->str = strdup(str))) {
+			free(interned);
+			return NULL;
+		}
+		interned->refs = 0;
+		hash_set(interned_strings, interned->str, interned);
+	}
+	interned->refs++;
+	return interned->str;
+}
+
+char *find_interned_string(const char *str) {
+	if (!interned_strings) {
+		return NULL;
+	}
+	struct interned_string *interned = hash_get(interned_strings, str);
+	return interned ? interned->str : NULL;
+}
+
+void release_interned_string(char *str) {
+	if (!str) {
+		return;
+	}
+	struct interned_string *interned = hash_get(interned_strings, str);
+	if (!sway_assert(interned && interned->str == str,
+				"Releasing string that wasn't interned: %s", str)) {
+		return;
+	}
+	if (--interned->refs == 0) {
+		hash_del(interned_strings, str);
+		free(interned->str);
+		free(interned);
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef _SWAY_CLIENT_BACKGROUND_H
+#define _SWAY_CLIENT_BACKGROUND_H
+
+#include <stdbool.h>
+#include <cairo/cairo.h>
+#include "list.h"
+
+enum scaling_mode {
+	SCALING_MODE_STRETCH,
+	SCALING_MODE_FILL,
+	SCALING_MODE_FIT,
+	SCALING_MODE_CENTER,
+	SCALING_MODE_TILE,
+};
+
+/**
+ * A decoded background image together with copies of it already scaled to the
+ * pixel size of the outputs it is shown on.
+ */
+struct background_image {
+	cairo_surface_t *image;
+	list_t *scaled; // struct scaled_image
+};
+
+struct scaled_image {
+	int width, height;
+	enum scaling_mode mode;
+	cairo_surface_t *surface;
+};
+
+/**
+ * Parses a scaling mode name. Returns false if the name is unknown.
+ */
+bool parse_scaling_mode(const char *name, enum scaling_mode *mode);
+
+/**
+ * Decodes the image at path. Returns NULL on failure.
+ */
+struct background_image *load_background_image(const char *path);
+
+void free_background_image(struct background_image *image);
+
+/**
+ * Returns the image scaled to width x height pixels with the given mode,
+ * rendering it on first use. Outputs with the same pixel size and mode share
+ * the same surface.
+ */
+cairo_surface_t *get_scaled_image(struct background_image *image,
+		int width, int height, enum scaling_mode mode);
+
+/**
+ * Paints the image onto a width x height pixel buffer.
+ */
+void render_background_image(cairo_t *cairo, struct background_image *image,
+		int width, int height, enum scaling_mode mode);
+
+#endif
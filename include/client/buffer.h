@@ -3,6 +3,16 @@
 
 #include "client/window.h"
 
+/**
+ * Returns a buffer from the window's pool that is not held by the compositor,
+ * sized for the window. Returns NULL if every buffer is busy and the pool
+ * cannot grow any further.
+ */
 struct buffer *get_next_buffer(struct window *state);
 
+/**
+ * Releases every buffer in the window's pool.
+ */
+void destroy_buffer_pool(struct window *state);
+
 #endif
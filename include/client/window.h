@@ -11,13 +11,34 @@
 
 struct window;
 
+#define BUFFER_POOL_MIN 2
+#define BUFFER_POOL_MAX 4
+// Frames with spare buffers after which the pool gives one back
+#define BUFFER_POOL_SHRINK_FRAMES 120
+
 struct buffer {
 	struct wl_buffer *buffer;
+	struct wl_shm_pool *pool;
+	void *data;
+	size_t size; // capacity of the mapping, may exceed width * height * 4
 	cairo_surface_t *surface;
 	cairo_t *cairo;
 	PangoContext *pango;
 	uint32_t width, height;
 	bool busy;
+	bool blank; // contents are undefined until the buffer is fully painted
+};
+
+struct buffer_pool {
+	struct buffer buffers[BUFFER_POOL_MAX];
+	int count;
+	// consecutive frames in which more than one buffer was free
+	unsigned int idle;
+
+	// statistics
+	unsigned int allocations; // new shm mappings
+	unsigned int reuses; // resizes served from an existing mapping
+	unsigned int starved; // frames with every buffer held by the compositor
 };
 
 struct cursor {
@@ -44,7 +65,7 @@ struct pointer_input {
 
 struct window {
 	struct registry *registry;
-	struct buffer buffers[2];
+	struct buffer_pool pool;
 	struct buffer *buffer;
 	struct wl_surface *surface;
 	struct wl_shell_surface *shell_surface;
@@ -62,6 +83,11 @@ struct window *window_setup(struct registry *registry, uint32_t width, uint32_t
 void window_teardown(struct window *state);
 int window_prerender(struct window *state);
 int window_render(struct window *state);
+/**
+ * Like window_render, but only damages the given region in surface
+ * coordinates. The rest of the buffer must already hold valid contents.
+ */
+int window_render_region(struct window *state, int x, int y, int width, int height);
 void window_make_shell(struct window *window);
 
 #endif
@@ -0,0 +1,44 @@
+#ifndef _SWAY_HASH_H
+#define _SWAY_HASH_H
+#include <stdbool.h>
+
+struct hash_entry {
+	const void *key;
+	void *value;
+	unsigned int hash;
+	struct hash_entry *next;
+};
+
+typedef struct {
+	int size;
+	int length;
+	struct hash_entry **buckets;
+	unsigned int (*hash)(const void *key);
+	int (*compare)(const void *a, const void *b);
+} hash_t;
+
+// Keys are not copied, they must stay valid for as long as they are in the
+// table. compare returns 0 for equal keys.
+hash_t *create_hash(unsigned int (*hash)(const void *key),
+		int (*compare)(const void *a, const void *b));
+// Frees the table, but neither the keys nor the values.
+void hash_free(hash_t *hash);
+void *hash_get(hash_t *hash, const void *key);
+// Replaces and returns the previous value if the key is already present.
+void *hash_set(hash_t *hash, const void *key, void *value);
+// Returns the removed value, or NULL if the key wasn't present.
+void *hash_del(hash_t *hash, const void *key);
+bool hash_contains(hash_t *hash, const void *key);
+void hash_foreach(hash_t *hash, void (*callback)(const void *key, void *value, void *data), void *data);
+void hash_clear(hash_t *hash);
+
+// Hash and compare functions for common key types
+unsigned int hash_string(const void *key);
+unsigned int hash_string_nocase(const void *key);
+int hash_string_cmp(const void *a, const void *b);
+int hash_string_casecmp(const void *a, const void *b);
+unsigned int hash_pointer(const void *key);
+int hash_pointer_cmp(const void *a, const void *b);
+// Mixes an integer into a well distributed hash value.
+unsigned int hash_int(unsigned int value);
+#endif
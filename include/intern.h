@@ -0,0 +1,20 @@
+#ifndef _SWAY_INTERN_H
+#define _SWAY_INTERN_H
+
+/**
+ * Returns a shared, reference counted copy of str. Equal strings map to the
+ * same pointer, so interned strings can be compared by address. Release with
+ * release_interned_string, never free.
+ */
+char *intern_string(const char *str);
+
+/**
+ * Returns the interned copy of str if one exists, without taking a reference.
+ */
+char *find_interned_string(const char *str);
+
+/**
+ * Drops a reference to an interned string. NULL is ignored.
+ */
+void release_interned_string(char *str);
+#endif
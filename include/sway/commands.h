@@ -58,16 +58,35 @@ int sp_index;
  * Parse and handles a command.
  */
 struct cmd_results *handle_command(char *command, enum command_context context);
+/**
+ * Recomputes the command policy of every command handler. Called whenever
+ * the command policies change.
+ */
+void update_command_policies(void);
+/**
+ * Parses a command list once so it can be run repeatedly, e.g. by a binding.
+ * Handlers and criteria are resolved and the command policy is checked for
+ * the given context up front. Errors are reported when the list is run, at
+ * the point handle_command would have hit them.
+ */
+struct compiled_commands *compile_commands(const char *command, enum command_context context);
+struct cmd_results *run_compiled_commands(struct compiled_commands *commands);
+/**
+ * Returns true if any of the compiled commands is handled by `handle`.
+ */
+bool compiled_commands_call(struct compiled_commands *commands,
+		struct cmd_results *(*handle)(int argc, char **argv));
+void free_compiled_commands(struct compiled_commands *commands);
 /**
  * Parse and handles a command during config file loading.
  *
  * Do not use this under normal conditions.
  */
-struct cmd_results *config_command(char *command, enum cmd_status block);
+struct cmd_results *config_command(struct config_line *line, enum cmd_status block);
 /*
  * Parses a command policy rule.
  */
-struct cmd_results *config_commands_command(char *exec);
+struct cmd_results *config_commands_command(struct config_line *line);
 
 /**
  * Allocates a cmd_results object.
@@ -152,6 +171,7 @@ sway_cmd cmd_splith;
 sway_cmd cmd_splitt;
 sway_cmd cmd_splitv;
 sway_cmd cmd_sticky;
+sway_cmd cmd_title_update_rate;
 sway_cmd cmd_unmark;
 sway_cmd cmd_workspace;
 sway_cmd cmd_ws_auto_back_and_forth;
@@ -11,6 +11,7 @@
 #include <time.h>
 #include "wayland-desktop-shell-server-protocol.h"
 #include "list.h"
+#include "hash.h"
 #include "layout.h"
 #include "container.h"
 
@@ -22,6 +23,17 @@ struct sway_variable {
 	char *value;
 };
 
+/**
+ * A non-empty, non-comment line of a config file, already split into
+ * arguments.
+ */
+struct config_line {
+	int number;
+	char *text;
+	int argc;
+	char **argv;
+};
+
 /**
  * A key binding and an associated command.
  */
@@ -32,6 +44,8 @@ struct sway_binding {
 	list_t *keys;
 	uint32_t modifiers;
 	char *command;
+	// command parsed ahead of time, NULL if that failed
+	struct compiled_commands *compiled;
 };
 
 /**
@@ -48,6 +62,11 @@ struct sway_mouse_binding {
 struct sway_mode {
 	char *name;
 	list_t *bindings;
+	// bindings by modifiers and key, NULL until built
+	hash_t *binding_index;
+	// workspace names targeted by `workspace <name>` bindings, in the order
+	// the bindings were defined, built along with binding_index
+	list_t *workspace_names;
 };
 
 /**
@@ -98,9 +117,9 @@ struct workspace_output {
 };
 
 struct pid_workspace {
-	pid_t *pid;
+	pid_t pid;
 	char *workspace;
-	time_t *time_added;
+	time_t time_added;
 };
 
 struct bar_config {
@@ -242,11 +261,15 @@ struct ipc_policy {
  */
 struct sway_config {
 	list_t *symbols;
+	// Variables by the character following their $, longest name first
+	list_t *symbol_index[256];
 	list_t *modes;
 	list_t *bars;
 	list_t *cmd_queue;
 	list_t *workspace_outputs;
 	list_t *pid_workspaces;
+	// pid_workspaces by pid, see pid_workspace_find
+	hash_t *pid_workspace_index;
 	list_t *output_configs;
 	list_t *input_configs;
 	list_t *criteria;
@@ -265,6 +288,8 @@ struct sway_config {
 	enum swayc_layouts default_layout;
 	char *font;
 	int font_height;
+	// title changes applied per view and second, 0 for no limit
+	int title_update_rate;
 
 	// Flags
 	bool focus_follows_mouse;
@@ -312,9 +337,21 @@ struct sway_config {
 	list_t *command_policies;
 	list_t *feature_policies;
 	list_t *ipc_policies;
+	// Policies by program path, or by command for command_policies
+	hash_t *command_policy_index;
+	hash_t *feature_policy_index;
+	hash_t *ipc_policy_index;
 };
 
 void pid_workspace_add(struct pid_workspace *pw);
+/**
+ * Returns the workspace assignment of exactly this pid, if any.
+ */
+struct pid_workspace *pid_workspace_find(pid_t pid);
+/**
+ * Removes and frees a workspace assignment.
+ */
+void pid_workspace_del(struct pid_workspace *pw);
 void free_pid_workspace(struct pid_workspace *pw);
 
 /**
@@ -328,11 +365,6 @@ bool load_main_config(const char *path, bool is_active);
  */
 bool load_include_configs(const char *path, struct sway_config *config);
 
-/**
- * Reads the config from the given FILE.
- */
-bool read_config(FILE *file, struct sway_config *config);
-
 /**
  * Free config struct
  */
@@ -347,6 +379,10 @@ struct cmd_results *check_security_config();
 int input_identifier_cmp(const void *item, const void *data);
 void merge_input_config(struct input_config *dst, struct input_config *src);
 void apply_input_config(struct input_config *ic, struct libinput_device *dev);
+/**
+ * Applies the input config to the connected device it identifies, if any.
+ */
+void apply_input_config_by_identifier(struct input_config *ic);
 void free_input_config(struct input_config *ic);
 
 int output_name_cmp(const void *item, const void *data);
@@ -369,13 +405,49 @@ int sway_binding_cmp_keys(const void *a, const void *b);
 void free_sway_binding(struct sway_binding *sb);
 struct sway_binding *sway_binding_dup(struct sway_binding *sb);
 
+/**
+ * (Re)builds the lookup table of bindings for a mode. Called once the config
+ * is loaded, and lazily after bindings were changed.
+ */
+void build_binding_index(struct sway_mode *mode);
+void free_binding_index(struct sway_mode *mode);
+/**
+ * Returns the bindings of a mode that trigger on key with exactly the given
+ * modifiers, in the same order as mode->bindings, or NULL if there are none.
+ * Release bindings are looked up by key sym, others by key sym or key code.
+ */
+list_t *get_bindings_for_key(struct sway_mode *mode, uint32_t modifiers,
+		uint32_t key, bool bindcode, bool release);
+/**
+ * Returns the workspace names bindings of a mode switch to, ordered by
+ * binding definition. Used to name new workspaces.
+ */
+list_t *get_binding_workspace_names(struct sway_mode *mode);
+/**
+ * Returns the binding of a mode that a key press triggers, or NULL. Every key
+ * of the binding has to be held, see press_key.
+ */
+struct sway_binding *find_press_binding(struct sway_mode *mode,
+		uint32_t modifiers, uint32_t keysym, uint32_t keycode);
+/**
+ * Returns the release binding of a mode that the last released key triggers,
+ * or NULL.
+ */
+struct sway_binding *find_release_binding(struct sway_mode *mode, uint32_t modifiers);
+
 int sway_mouse_binding_cmp(const void *a, const void *b);
 int sway_mouse_binding_cmp_qsort(const void *a, const void *b);
 int sway_mouse_binding_cmp_buttons(const void *a, const void *b);
 void free_sway_mouse_binding(struct sway_mouse_binding *smb);
 
 void load_swaybars();
-void terminate_swaybg(pid_t pid);
+
+/**
+ * Spawns a single swaybg for the backgrounds of all outputs, or terminates it
+ * if there are none. Nothing happens if the backgrounds did not change.
+ */
+void load_swaybg(void);
+void terminate_swaybg(void);
 
 /**
  * Allocate and initialize default bar configuration.
@@ -108,18 +108,32 @@ struct sway_container {
 	 * workspace that is not shown.
 	 */
 	bool visible;
+	/**
+	 * Workspaces only: the contents were not arranged because the workspace
+	 * was hidden. Only its own size is current until it is shown again.
+	 */
+	bool layout_stale;
 	bool is_floating;
 	bool is_focused;
 	bool sticky; // floating view always visible on its output
 
-	// Attributes that mostly views have.
+	// Attributes that mostly views have. class, instance and app_id are
+	// interned (see intern.h).
 	char *name;
 	char *class;
 	char *instance;
 	char *app_id;
 
-	// Used by output containers to keep track of swaybg child processes.
-	pid_t bg_pid;
+	/**
+	 * Feature policy of the view's program, cached until the policies are
+	 * reloaded. Only valid if feature_policy_generation is current.
+	 */
+	uint32_t feature_policy;
+	unsigned int feature_policy_generation;
+
+	// Used by output containers to keep track of the background swaybg shows.
+	char *background;
+	char *background_option;
 
 	int gaps;
 
@@ -270,6 +284,16 @@ swayc_t *swayc_active_workspace_for(swayc_t *view);
  * Finds the container currently underneath the pointer.
  */
 swayc_t *container_under_pointer(void);
+/**
+ * Finds the container on the workspace whose title bar is at origin.
+ */
+swayc_t *container_title_bar_at(swayc_t *workspace, const struct wlc_point *origin);
+/**
+ * Marks the hit testing index of container_under_pointer and
+ * container_title_bar_at as stale. Needs to be called whenever containers
+ * are moved, resized, restacked, shown, hidden or refocused.
+ */
+void invalidate_container_index(void);
 /**
  * Finds the first container following a callback.
  */
@@ -322,6 +346,28 @@ int swayc_gap(swayc_t *container);
  */
 void container_map(swayc_t *, void (*f)(swayc_t *, void *), void *);
 
+/**
+ * Returns the container holding the given mark, or NULL.
+ */
+swayc_t *container_by_mark(const char *mark);
+/**
+ * Calls f for every mark set on any container.
+ */
+void container_marks_foreach(void (*f)(const char *mark, swayc_t *container, void *data), void *data);
+/**
+ * Adds a mark to a container, taking ownership of it. Marks are unique, so it
+ * is removed from any other container holding it.
+ */
+void container_add_mark(swayc_t *container, char *mark);
+/**
+ * Removes a mark from a container. Returns false if it didn't have it.
+ */
+bool container_remove_mark(swayc_t *container, const char *mark);
+/**
+ * Removes all marks from a container.
+ */
+void container_clear_marks(swayc_t *container);
+
 /**
  * Set a view as visible or invisible.
  *
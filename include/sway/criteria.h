@@ -29,6 +29,9 @@ void free_criteria(struct criteria *crit);
 // string or NULL if successful.
 char *extract_crit_tokens(list_t *tokens, const char *criteria);
 
+// Frees a list of crit_tokens
+void free_crit_tokens(list_t *crit_tokens);
+
 // Returns list of criteria that match given container. These criteria have
 // been set with `for_window` commands and have an associated cmdlist.
 list_t *criteria_for(swayc_t *cont);
@@ -36,6 +39,11 @@ list_t *criteria_for(swayc_t *cont);
 // Returns a list of all containers that match the given list of tokens.
 list_t *container_for(list_t *tokens);
 
+// Adds a new view to/removes a view from the attribute indexes container_for
+// narrows its search with.
+void index_view(swayc_t *view);
+void unindex_view(swayc_t *view);
+
 // Returns true if any criteria in the given list matches this container
 bool criteria_any(swayc_t *cont, list_t *criteria);
 
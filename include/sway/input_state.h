@@ -12,6 +12,9 @@ bool check_key(uint32_t key_sym, uint32_t key_code);
 // returns true if key_sym matches latest released key.
 bool check_released_key(uint32_t key_sym);
 
+// gets the key syms of the latest released key, 0 if unset
+void get_released_key(uint32_t *key_sym, uint32_t *alt_sym);
+
 // sets a key as pressed
 void press_key(uint32_t key_sym, uint32_t key_code);
 
@@ -76,9 +79,13 @@ void center_pointer_on(swayc_t *view);
 // on button press set mode conditionally depending on the button
 void pointer_mode_set(uint32_t button, bool condition);
 
-// Update mode in mouse motion
+// Update mode in mouse motion. Motion is coalesced, the latest position is
+// only applied by pointer_mode_flush.
 void pointer_mode_update(void);
 
+// Apply pending mode motion, called once per output frame
+void pointer_mode_flush(void);
+
 // Reset mode on any keypress;
 void pointer_mode_reset(void);
 
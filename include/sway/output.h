@@ -4,12 +4,30 @@
 #include "container.h"
 #include "focus.h"
 
+enum output_change {
+	OUTPUT_ADDED,
+	OUTPUT_REMOVED,
+	OUTPUT_RESIZED,
+};
+
+/**
+ * Outputs tend to be added, removed and resized in bursts, e.g. when docking.
+ * Every change to the set of outputs schedules one settle a short while
+ * after the last change of a burst, which arranges all windows once. Added
+ * outputs also respawn swaybar, added and removed ones reload swaybg.
+ */
+void schedule_output_settle(enum output_change change);
+
 // Position is absolute coordinates on the edge where the adjacent output
 // should be searched for.
 swayc_t *output_by_name(const char* name, const struct wlc_point *abs_pos);
 swayc_t *swayc_opposite_output(enum movement_direction dir, const struct wlc_point *abs_pos);
 swayc_t *swayc_adjacent_output(swayc_t *output, enum movement_direction dir, const struct wlc_point *abs_pos, bool pick_closest);
 
+// Outputs bordering each other are looked up in a cached graph, which has to
+// be invalidated whenever outputs are added, removed, moved or resized.
+void invalidate_output_neighbors(void);
+
 // Place absolute coordinates for given container into given wlc_point.
 void get_absolute_position(swayc_t *container, struct wlc_point *point);
 
@@ -20,6 +38,9 @@ void get_absolute_center_position(swayc_t *container, struct wlc_point *point);
 // stable sort workspaces on this output
 void sort_workspaces(swayc_t *output);
 
+// index to insert a new workspace at to keep the workspaces of output sorted
+int workspace_sort_index(swayc_t *output, swayc_t *workspace);
+
 void output_get_scaled_size(wlc_handle handle, struct wlc_size *size);
 
 #endif
@@ -4,6 +4,15 @@
 #include "sway/config.h"
 
 uint32_t get_feature_policy_mask(pid_t pid);
+/**
+ * Feature policy of a view's program, resolved once per view and cached
+ * until the policies change.
+ */
+uint32_t get_view_feature_policy_mask(swayc_t *view);
+/**
+ * Drops all cached policy lookups. Called once the config was (re)loaded.
+ */
+void invalidate_policy_cache(void);
 uint32_t get_ipc_policy_mask(pid_t pid);
 uint32_t get_command_policy_mask(const char *cmd);
 
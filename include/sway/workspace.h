@@ -19,4 +19,9 @@ swayc_t *workspace_output_prev();
 swayc_t *workspace_prev();
 swayc_t *workspace_for_pid(pid_t pid);
 
+// Keep workspace_by_name and workspace_by_number up to date, called when a
+// workspace is created and freed.
+void index_workspace(swayc_t *workspace);
+void unindex_workspace(swayc_t *workspace);
+
 #endif
@@ -24,6 +24,10 @@ struct output {
 	char *name;
 	int idx;
 	bool focused;
+	/* pending update, rendered on the next frame callback */
+	bool dirty;
+	/* updates coalesced into an already pending render */
+	unsigned int renders_skipped;
 };
 
 struct workspace {
@@ -48,7 +52,8 @@ void bar_setup(struct bar *bar, const char *socket_path, const char *bar_id);
 struct output *new_output(const char *name);
 
 /**
- * Bar mainloop.
+ * Bar mainloop. Updates are coalesced and each output renders at most once
+ * per frame callback.
  */
 void bar_run(struct bar *bar);
 
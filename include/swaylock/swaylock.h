@@ -1,16 +1,9 @@
 #ifndef _SWAYLOCK_H
 #define _SWAYLOCK_H
 
+#include "client/background.h"
 #include "client/cairo.h"
 
-enum scaling_mode {
-	SCALING_MODE_STRETCH,
-	SCALING_MODE_FILL,
-	SCALING_MODE_FIT,
-	SCALING_MODE_CENTER,
-	SCALING_MODE_TILE,
-};
-
 enum auth_state {
 	AUTH_STATE_IDLE,
 	AUTH_STATE_INPUT,
@@ -27,10 +20,12 @@ enum line_source {
 
 struct render_data {
 	list_t *surfaces;
+	// Background of each surface, painted once and reused on every redraw
+	cairo_surface_t **backgrounds;
 	// Output specific images
-	cairo_surface_t **images;
+	struct background_image **images;
 	// OR one image for all outputs:
-	cairo_surface_t *image;
+	struct background_image *image;
 	int num_images;
 	int color_set;
 	uint32_t color;
@@ -0,0 +1,331 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <xkbcommon/xkbcommon.h>
+#include <wlc/wlc.h>
+#include "sway/config.h"
+#include "sway/input_state.h"
+#include "stringop.h"
+#include "hash.h"
+#include "list.h"
+#include "log.h"
+
+int sway_binding_cmp_keys(const void *a, const void *b) {
+	const struct sway_binding *binda = a, *bindb = b;
+
+	// Count keys pressed for this binding. important so we check long before
+	// short ones.  for example mod+a+b  before  mod+a
+	unsigned int moda = 0, modb = 0, i;
+
+	// Count how any modifiers are pressed
+	for (i = 0; i < 8 * sizeof(binda->modifiers); ++i) {
+		moda += (binda->modifiers & 1 << i) != 0;
+		modb += (bindb->modifiers & 1 << i) != 0;
+	}
+	if (bindb->keys->length + modb != binda->keys->length + moda) {
+		return (bindb->keys->length + modb) - (binda->keys->length + moda);
+	}
+
+	// Otherwise compare keys
+	if (binda->modifiers > bindb->modifiers) {
+		return 1;
+	} else if (binda->modifiers < bindb->modifiers) {
+		return -1;
+	}
+	struct wlc_modifiers no_mods = { 0, 0 };
+	for (int i = 0; i < binda->keys->length; i++) {
+		xkb_keysym_t ka = *(xkb_keysym_t *)binda->keys->items[i],
+			kb = *(xkb_keysym_t *)bindb->keys->items[i];
+		if (binda->bindcode) {
+			uint32_t *keycode = binda->keys->items[i];
+			ka = wlc_keyboard_get_keysym_for_key(*keycode, &no_mods);
+		}
+
+		if (bindb->bindcode) {
+			uint32_t *keycode = bindb->keys->items[i];
+			kb = wlc_keyboard_get_keysym_for_key(*keycode, &no_mods);
+		}
+
+		if (ka > kb) {
+			return 1;
+		} else if (ka < kb) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int sway_binding_cmp(const void *a, const void *b) {
+	int cmp = 0;
+	if ((cmp = sway_binding_cmp_keys(a, b)) != 0) {
+		return cmp;
+	}
+	const struct sway_binding *binda = a, *bindb = b;
+	return lenient_strcmp(binda->command, bindb->command);
+}
+
+int sway_binding_cmp_qsort(const void *a, const void *b) {
+	return sway_binding_cmp(*(void **)a, *(void **)b);
+}
+
+struct binding_bucket {
+	uint32_t modifiers;
+	uint32_t key;
+	bool bindcode;
+	bool release;
+	list_t *bindings;
+};
+
+static unsigned int binding_bucket_hash(const void *key) {
+	const struct binding_bucket *bucket = key;
+	return hash_int(bucket->key ^ hash_int(bucket->modifiers))
+		^ (bucket->bindcode << 1 | bucket->release);
+}
+
+static int binding_bucket_cmp(const void *a, const void *b) {
+	const struct binding_bucket *ba = a, *bb = b;
+	return ba->modifiers != bb->modifiers || ba->key != bb->key
+		|| ba->bindcode != bb->bindcode || ba->release != bb->release;
+}
+
+static void free_binding_bucket(const void *key, void *value, void *data) {
+	struct binding_bucket *bucket = value;
+	list_free(bucket->bindings);
+	free(bucket);
+}
+
+void free_binding_index(struct sway_mode *mode) {
+	if (mode->workspace_names) {
+		free_flat_list(mode->workspace_names);
+		mode->workspace_names = NULL;
+	}
+	if (!mode->binding_index) {
+		return;
+	}
+	hash_foreach(mode->binding_index, free_binding_bucket, NULL);
+	hash_free(mode->binding_index);
+	mode->binding_index = NULL;
+}
+
+static void index_binding(hash_t *index, struct sway_binding *binding,
+		uint32_t key, bool bindcode) {
+	struct binding_bucket find = {
+		.modifiers = binding->modifiers,
+		.key = key,
+		.bindcode = bindcode,
+		.release = binding->release,
+	};
+	struct binding_bucket *bucket = hash_get(index, &find);
+	if (!bucket) {
+		if (!(bucket = malloc(sizeof(struct binding_bucket)))) {
+			return;
+		}
+		*bucket = find;
+		bucket->bindings = create_list();
+		hash_set(index, bucket, bucket);
+	}
+	// a binding listing the same key twice only needs one entry
+	if (bucket->bindings->length == 0 ||
+			bucket->bindings->items[bucket->bindings->length - 1] != binding) {
+		list_add(bucket->bindings, binding);
+	}
+}
+
+struct binding_workspace {
+	int order;
+	char *name;
+};
+
+static int binding_workspace_cmp(const void *_a, const void *_b) {
+	const struct binding_workspace *a = *(void **)_a;
+	const struct binding_workspace *b = *(void **)_b;
+	return (a->order > b->order) - (a->order < b->order);
+}
+
+/**
+ * Returns the workspace a `workspace <name>` binding switches to, or NULL if
+ * the binding doesn't reference an actual workspace.
+ */
+static char *binding_workspace_name(struct sway_binding *binding) {
+	char *cmdlist = strdup(binding->command);
+	if (!cmdlist) {
+		return NULL;
+	}
+	char *dup = cmdlist;
+	char *name = NULL;
+
+	// workspace n
+	char *cmd = argsep(&cmdlist, " ");
+	if (cmdlist) {
+		name = argsep(&cmdlist, " ,;");
+	}
+	char *target = NULL;
+	if (strcmp("workspace", cmd) == 0 && name) {
+		strip_quotes(name);
+		while (isspace(*name)) {
+			name++;
+		}
+		// Make sure that the command references an actual workspace
+		// not a command about workspaces
+		if (strcmp(name, "next") != 0 &&
+				strcmp(name, "prev") != 0 &&
+				strcmp(name, "next_on_output") != 0 &&
+				strcmp(name, "prev_on_output") != 0 &&
+				strcmp(name, "number") != 0 &&
+				strcmp(name, "back_and_forth") != 0 &&
+				strcmp(name, "current") != 0) {
+			target = strdup(name);
+		}
+	}
+	free(dup);
+	return target;
+}
+
+static void build_binding_workspace_names(struct sway_mode *mode) {
+	list_t *targets = create_list();
+	for (int i = 0; i < mode->bindings->length; ++i) {
+		struct sway_binding *binding = mode->bindings->items[i];
+		char *name = binding_workspace_name(binding);
+		if (!name) {
+			continue;
+		}
+		struct binding_workspace *target = malloc(sizeof(struct binding_workspace));
+		if (!target) {
+			free(name);
+			continue;
+		}
+		target->order = binding->order;
+		target->name = name;
+		list_add(targets, target);
+	}
+	list_stable_sort(targets, binding_workspace_cmp);
+
+	mode->workspace_names = create_list();
+	for (int i = 0; i < targets->length; ++i) {
+		struct binding_workspace *target = targets->items[i];
+		list_add(mode->workspace_names, target->name);
+		free(target);
+	}
+	list_free(targets);
+}
+
+list_t *get_binding_workspace_names(struct sway_mode *mode) {
+	if (!mode->workspace_names) {
+		build_binding_index(mode);
+	}
+	return mode->workspace_names;
+}
+
+void build_binding_index(struct sway_mode *mode) {
+	free_binding_index(mode);
+	build_binding_workspace_names(mode);
+	if (!(mode->binding_index = create_hash(binding_bucket_hash, binding_bucket_cmp))) {
+		sway_log(L_ERROR, "Unable to allocate binding index for mode %s", mode->name);
+		return;
+	}
+	// bindings are already sorted by priority, which each bucket preserves
+	for (int i = 0; i < mode->bindings->length; ++i) {
+		struct sway_binding *binding = mode->bindings->items[i];
+		if (binding->release) {
+			// only single key release bindings can trigger
+			if (binding->keys->length == 1) {
+				index_binding(mode->binding_index, binding,
+						*(uint32_t *)binding->keys->items[0], false);
+			}
+			continue;
+		}
+		for (int j = 0; j < binding->keys->length; ++j) {
+			index_binding(mode->binding_index, binding,
+					*(uint32_t *)binding->keys->items[j], binding->bindcode);
+		}
+	}
+	sway_log(L_DEBUG, "Indexed %d bindings of mode %s into %d buckets, %d workspace names",
+			mode->bindings->length, mode->name, mode->binding_index->length,
+			mode->workspace_names->length);
+}
+
+list_t *get_bindings_for_key(struct sway_mode *mode, uint32_t modifiers,
+		uint32_t key, bool bindcode, bool release) {
+	if (!mode->binding_index) {
+		build_binding_index(mode);
+		if (!mode->binding_index) {
+			return NULL;
+		}
+	}
+	struct binding_bucket find = {
+		.modifiers = modifiers,
+		.key = key,
+		.bindcode = bindcode && !release,
+		.release = release,
+	};
+	struct binding_bucket *bucket = hash_get(mode->binding_index, &find);
+	return bucket ? bucket->bindings : NULL;
+}
+
+static bool valid_bindsym(struct sway_binding *binding) {
+	bool match = false;
+	int i;
+	for (i = 0; i < binding->keys->length; ++i) {
+		if (binding->bindcode) {
+			xkb_keycode_t *key = binding->keys->items[i];
+			if ((match = check_key(0, *key)) == false) {
+				break;
+			}
+		} else {
+			xkb_keysym_t *key = binding->keys->items[i];
+			if ((match = check_key(*key, 0)) == false) {
+				break;
+			}
+		}
+	}
+
+	return match;
+}
+
+static struct sway_binding *first_valid_bindsym(list_t *bindings) {
+	if (!bindings) {
+		return NULL;
+	}
+	for (int i = 0; i < bindings->length; ++i) {
+		struct sway_binding *binding = bindings->items[i];
+		if (valid_bindsym(binding)) {
+			return binding;
+		}
+	}
+	return NULL;
+}
+
+// Returns whichever binding comes first in the mode's binding order
+static struct sway_binding *preferred_binding(struct sway_binding *a, struct sway_binding *b) {
+	if (!a || !b) {
+		return a ? a : b;
+	}
+	return sway_binding_cmp(a, b) <= 0 ? a : b;
+}
+
+struct sway_binding *find_press_binding(struct sway_mode *mode,
+		uint32_t modifiers, uint32_t keysym, uint32_t keycode) {
+	struct sway_binding *by_sym = first_valid_bindsym(
+			get_bindings_for_key(mode, modifiers, keysym, false, false));
+	struct sway_binding *by_code = first_valid_bindsym(
+			get_bindings_for_key(mode, modifiers, keycode, true, false));
+	return preferred_binding(by_sym, by_code);
+}
+
+struct sway_binding *find_release_binding(struct sway_mode *mode, uint32_t modifiers) {
+	uint32_t key_sym, alt_sym;
+	get_released_key(&key_sym, &alt_sym);
+
+	struct sway_binding *by_sym = NULL, *by_alt = NULL;
+	list_t *bindings;
+	if (key_sym && (bindings = get_bindings_for_key(mode, modifiers, key_sym, false, true))) {
+		by_sym = bindings->items[0];
+	}
+	if (alt_sym && (bindings = get_bindings_for_key(mode, modifiers, alt_sym, false, true))) {
+		by_alt = bindings->items[0];
+	}
+	return preferred_binding(by_sym, by_alt);
+}
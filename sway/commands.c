@@ -116,24 +116,12 @@ void input_cmd_apply(struct input_config *input) {
 
 	current_input_config = input;
 
-	if (input->identifier) {
+	if (input->identifier && !config->reloading) {
 		// Try to find the input device and apply configuration now. If
 		// this is during startup then there will be no container and config
-		// will be applied during normal "new input" event from wlc.
-		struct libinput_device *device = NULL;
-		for (int i = 0; i < input_devices->length; ++i) {
-			device = input_devices->items[i];
-			char* dev_identifier = libinput_dev_unique_id(device);
-			if (!dev_identifier) {
-				break;
-			}
-			int match = dev_identifier && strcmp(dev_identifier, input->identifier) == 0;
-			free(dev_identifier);
-			if (match) {
-				apply_input_config(input, device);
-				break;
-			}
-		}
+		// will be applied during normal "new input" event from wlc. A reload
+		// applies what changed once the whole config has been read.
+		apply_input_config_by_identifier(input);
 	}
 }
 
@@ -214,6 +202,7 @@ static struct cmd_handler handlers[] = {
 	{ "splitt", cmd_splitt },
 	{ "splitv", cmd_splitv },
 	{ "sticky", cmd_sticky },
+	{ "title_update_rate", cmd_title_update_rate },
 	{ "unmark", cmd_unmark },
 	{ "workspace", cmd_workspace },
 	{ "workspace_auto_back_and_forth", cmd_ws_auto_back_and_forth },
@@ -365,19 +354,96 @@ static struct cmd_handler *find_handler(char *line, enum cmd_status block) {
 	return res;
 }
 
-struct cmd_results *handle_command(char *_exec, enum command_context context) {
-	// Even though this function will process multiple commands we will only
-	// return the last error, if any (for now). (Since we have access to an
-	// error string we could e.g. concatonate all errors there.)
-	struct cmd_results *results = NULL;
+// Command policy of each entry in handlers, see update_command_policies
+static uint32_t handler_policies[sizeof(handlers) / sizeof(struct cmd_handler)];
+
+void update_command_policies(void) {
+	for (size_t i = 0; i < sizeof(handlers) / sizeof(struct cmd_handler); ++i) {
+		handler_policies[i] = get_command_policy_mask(handlers[i].command);
+	}
+}
+
+struct compiled_command {
+	struct cmd_handler *handler;
+	// false if the command policy forbids it in this context
+	bool permitted;
+	char *input;
+	int argc;
+	char **argv;
+};
+
+struct compiled_cmdlist {
+	// criteria tokens, or NULL to run on the focused container
+	list_t *tokens;
+	// set when the criteria couldn't be parsed, input is the criteria
+	char *error;
+	char *input;
+	list_t *commands;
+};
+
+struct compiled_commands {
+	enum command_context context;
+	// held by the owner and by every run in progress, a command may free
+	// the binding it was compiled for while it is still running
+	int refs;
+	list_t *cmdlists;
+};
+
+static void free_compiled_cmdlist(struct compiled_cmdlist *cmdlist) {
+	if (cmdlist->tokens) {
+		free_crit_tokens(cmdlist->tokens);
+	}
+	for (int i = 0; i < cmdlist->commands->length; ++i) {
+		struct compiled_command *cmd = cmdlist->commands->items[i];
+		free(cmd->input);
+		free_argv(cmd->argc, cmd->argv);
+		free(cmd);
+	}
+	list_free(cmdlist->commands);
+	free(cmdlist->error);
+	free(cmdlist->input);
+	free(cmdlist);
+}
+
+void free_compiled_commands(struct compiled_commands *commands) {
+	if (!commands || --commands->refs > 0) {
+		return;
+	}
+	for (int i = 0; i < commands->cmdlists->length; ++i) {
+		free_compiled_cmdlist(commands->cmdlists->items[i]);
+	}
+	list_free(commands->cmdlists);
+	free(commands);
+}
+
+static struct compiled_cmdlist *add_compiled_cmdlist(struct compiled_commands *commands) {
+	struct compiled_cmdlist *cmdlist = calloc(1, sizeof(struct compiled_cmdlist));
+	if (!cmdlist) {
+		return NULL;
+	}
+	cmdlist->commands = create_list();
+	list_add(commands->cmdlists, cmdlist);
+	return cmdlist;
+}
+
+struct compiled_commands *compile_commands(const char *_exec, enum command_context context) {
+	struct compiled_commands *commands = malloc(sizeof(struct compiled_commands));
+	if (!commands) {
+		return NULL;
+	}
+	commands->context = context;
+	commands->refs = 1;
+	commands->cmdlists = create_list();
+
 	char *exec = strdup(_exec);
 	char *head = exec;
-	char *cmdlist;
+	char *cmdlist_str;
 	char *cmd;
-	list_t *containers = NULL;
-
-	head = exec;
 	do {
+		struct compiled_cmdlist *cmdlist = add_compiled_cmdlist(commands);
+		if (!cmdlist) {
+			goto error;
+		}
 		// Extract criteria (valid for this command list only).
 		if (*head == '[') {
 			++head;
@@ -388,136 +454,189 @@ struct cmd_results *handle_command(char *_exec, enum command_context context) {
 				char *error;
 
 				if ((error = extract_crit_tokens(tokens, criteria_string))) {
-					results = cmd_results_new(CMD_INVALID, criteria_string,
-						"Can't parse criteria string: %s", error);
+					cmdlist->input = strdup(criteria_string);
+					cmdlist->error = malloc(strlen(error) + 32);
+					sprintf(cmdlist->error, "Can't parse criteria string: %s", error);
 					free(error);
-					free(tokens);
-					goto cleanup;
+					free_crit_tokens(tokens);
+					break;
 				}
-				containers = container_for(tokens);
-
-				free(tokens);
+				cmdlist->tokens = tokens;
 			} else {
-				if (!results) {
-					results = cmd_results_new(CMD_INVALID, criteria_string, "Unmatched [");
-				}
-				goto cleanup;
+				cmdlist->input = strdup(criteria_string);
+				cmdlist->error = strdup("Unmatched [");
+				break;
 			}
 			// Skip leading whitespace
 			head += strspn(head, whitespace);
 		}
 		// Split command list
-		cmdlist = argsep(&head, ";");
-		cmdlist += strspn(cmdlist, whitespace);
+		cmdlist_str = argsep(&head, ";");
+		cmdlist_str += strspn(cmdlist_str, whitespace);
 		do {
 			// Split commands
-			cmd = argsep(&cmdlist, ",");
+			cmd = argsep(&cmdlist_str, ",");
 			cmd += strspn(cmd, whitespace);
 			if (strcmp(cmd, "") == 0) {
 				sway_log(L_INFO, "Ignoring empty command.");
 				continue;
 			}
-			sway_log(L_INFO, "Handling command '%s'", cmd);
+			struct compiled_command *compiled = calloc(1, sizeof(struct compiled_command));
+			if (!compiled) {
+				goto error;
+			}
+			compiled->input = strdup(cmd);
 			//TODO better handling of argv
-			int argc;
-			char **argv = split_args(cmd, &argc);
-			if (strcmp(argv[0], "exec") != 0) {
+			compiled->argv = split_args(cmd, &compiled->argc);
+			if (strcmp(compiled->argv[0], "exec") != 0) {
 				int i;
-				for (i = 1; i < argc; ++i) {
-					if (*argv[i] == '\"' || *argv[i] == '\'') {
-						strip_quotes(argv[i]);
+				for (i = 1; i < compiled->argc; ++i) {
+					if (*compiled->argv[i] == '\"' || *compiled->argv[i] == '\'') {
+						strip_quotes(compiled->argv[i]);
 					}
 				}
 			}
-			struct cmd_handler *handler = find_handler(argv[0], CMD_BLOCK_END);
-			if (!handler) {
-				if (results) {
-					free_cmd_results(results);
-				}
-				results = cmd_results_new(CMD_INVALID, cmd, "Unknown/invalid command");
-				free_argv(argc, argv);
+			compiled->handler = find_handler(compiled->argv[0], CMD_BLOCK_END);
+			if (compiled->handler) {
+				compiled->permitted = handler_policies[compiled->handler - handlers] & context;
+			}
+			list_add(cmdlist->commands, compiled);
+			if (!compiled->handler) {
+				// Nothing after an unknown command would run
+				head = NULL;
+				break;
+			}
+		} while(cmdlist_str);
+	} while(head);
+
+	free(exec);
+	return commands;
+
+error:
+	sway_log(L_ERROR, "Unable to allocate compiled command");
+	free(exec);
+	free_compiled_commands(commands);
+	return NULL;
+}
+
+bool compiled_commands_call(struct compiled_commands *commands,
+		struct cmd_results *(*handle)(int argc, char **argv)) {
+	for (int i = 0; i < commands->cmdlists->length; ++i) {
+		struct compiled_cmdlist *cmdlist = commands->cmdlists->items[i];
+		for (int j = 0; j < cmdlist->commands->length; ++j) {
+			struct compiled_command *cmd = cmdlist->commands->items[j];
+			if (cmd->handler && cmd->handler->handle == handle) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+struct cmd_results *run_compiled_commands(struct compiled_commands *commands) {
+	// Even though this function will process multiple commands we will only
+	// return the last error, if any (for now). (Since we have access to an
+	// error string we could e.g. concatonate all errors there.)
+	struct cmd_results *results = NULL;
+	list_t *containers = NULL;
+	// keep the commands alive until the last one has run
+	++commands->refs;
+
+	for (int i = 0; i < commands->cmdlists->length; ++i) {
+		struct compiled_cmdlist *cmdlist = commands->cmdlists->items[i];
+		if (cmdlist->error) {
+			results = cmd_results_new(CMD_INVALID, cmdlist->input, "%s", cmdlist->error);
+			goto cleanup;
+		}
+		if (cmdlist->tokens) {
+			containers = container_for(cmdlist->tokens);
+		}
+		for (int j = 0; j < cmdlist->commands->length; ++j) {
+			struct compiled_command *cmd = cmdlist->commands->items[j];
+			sway_log(L_INFO, "Handling command '%s'", cmd->input);
+			if (!cmd->handler) {
+				results = cmd_results_new(CMD_INVALID, cmd->input, "Unknown/invalid command");
 				goto cleanup;
 			}
-			if (!(get_command_policy_mask(argv[0]) & context)) {
-				if (results) {
-					free_cmd_results(results);
-				}
-				results = cmd_results_new(CMD_INVALID, cmd,
-						"Permission denied for %s via %s", cmd,
-						command_policy_str(context));
-				free_argv(argc, argv);
+			if (!cmd->permitted) {
+				results = cmd_results_new(CMD_INVALID, cmd->input,
+						"Permission denied for %s via %s", cmd->input,
+						command_policy_str(commands->context));
 				goto cleanup;
 			}
-			int i = 0;
+			// handlers may shuffle their argv around, keep ours intact
+			char *argv[cmd->argc];
+			int k = 0;
 			do {
 				if (!containers) {
 					current_container = get_focused_container(&root_container);
 				} else if (containers->length == 0) {
 					break;
 				} else {
-					current_container = (swayc_t *)containers->items[i];
+					current_container = (swayc_t *)containers->items[k];
 				}
 				sway_log(L_INFO, "Running on container '%s'", current_container->name);
 
-				struct cmd_results *res = handler->handle(argc-1, argv+1);
+				memcpy(argv, cmd->argv, sizeof(argv));
+				struct cmd_results *res = cmd->handler->handle(cmd->argc-1, argv+1);
 				if (res->status != CMD_SUCCESS) {
-					free_argv(argc, argv);
-					if (results) {
-						free_cmd_results(results);
-					}
 					results = res;
 					goto cleanup;
 				}
 				free_cmd_results(res);
-				++i;
-			} while(containers && i < containers->length);
-
-			free_argv(argc, argv);
-		} while(cmdlist);
+				++k;
+			} while(containers && k < containers->length);
+		}
 
 		if (containers) {
 			list_free(containers);
 			containers = NULL;
 		}
-	} while(head);
+	}
 	cleanup:
-	free(exec);
 	if (containers) {
-		free(containers);
+		list_free(containers);
 	}
+	free_compiled_commands(commands);
 	if (!results) {
 		results = cmd_results_new(CMD_SUCCESS, NULL, NULL);
 	}
 	return results;
 }
 
+struct cmd_results *handle_command(char *_exec, enum command_context context) {
+	struct compiled_commands *commands = compile_commands(_exec, context);
+	if (!commands) {
+		return cmd_results_new(CMD_FAILURE, _exec, "Unable to parse command");
+	}
+	struct cmd_results *results = run_compiled_commands(commands);
+	free_compiled_commands(commands);
+	return results;
+}
+
 // this is like handle_command above, except:
 // 1) it ignores empty commands (empty lines)
 // 2) it does variable substitution
 // 3) it doesn't split commands (because the multiple commands are supposed to
 //	  be chained together)
 // 4) handle_command handles all state internally while config_command has some
-//	  state handled outside (notably the block mode, in read_config)
-struct cmd_results *config_command(char *exec, enum cmd_status block) {
-	struct cmd_results *results = NULL;
-	int argc;
-	char **argv = split_args(exec, &argc);
+//	  state handled outside (notably the block mode, in run_config_file)
+struct cmd_results *config_command(struct config_line *line, enum cmd_status block) {
+	int argc = line->argc;
+	char **argv = line->argv;
 	if (!argc) {
-		results = cmd_results_new(CMD_SUCCESS, NULL, NULL);
-		goto cleanup;
+		return cmd_results_new(CMD_SUCCESS, NULL, NULL);
 	}
 
-	sway_log(L_INFO, "handling config command '%s'", exec);
+	sway_log(L_INFO, "handling config command '%s'", line->text);
 	// Endblock
 	if (**argv == '}') {
-		results = cmd_results_new(CMD_BLOCK_END, NULL, NULL);
-		goto cleanup;
+		return cmd_results_new(CMD_BLOCK_END, NULL, NULL);
 	}
 	struct cmd_handler *handler = find_handler(argv[0], block);
 	if (!handler) {
 		char *input = argv[0] ? argv[0] : "(empty)";
-		results = cmd_results_new(CMD_INVALID, input, "Unknown/invalid command");
-		goto cleanup;
+		return cmd_results_new(CMD_INVALID, input, "Unknown/invalid command");
 	}
 	int i;
 	// Var replacement, for all but first argument of set
@@ -530,24 +649,21 @@ struct cmd_results *config_command(char *exec, enum cmd_status block) {
 	if (argc>1 && (*argv[1] == '\"' || *argv[1] == '\'')) {
 		strip_quotes(argv[1]);
 	}
-	if (handler->handle) {
-		results = handler->handle(argc-1, argv+1);
-	} else {
-		results = cmd_results_new(CMD_INVALID, argv[0], "This command is shimmed, but unimplemented");
+	if (!handler->handle) {
+		return cmd_results_new(CMD_INVALID, argv[0], "This command is shimmed, but unimplemented");
 	}
-
-cleanup:
-	free_argv(argc, argv);
-	return results;
+	// The handler may rearrange its arguments, line->argv keeps what is freed
+	char *args[argc];
+	memcpy(args, argv, sizeof(args));
+	return handler->handle(argc-1, args+1);
 }
 
-struct cmd_results *config_commands_command(char *exec) {
+struct cmd_results *config_commands_command(struct config_line *line) {
 	struct cmd_results *results = NULL;
-	int argc;
-	char **argv = split_args(exec, &argc);
+	int argc = line->argc;
+	char **argv = line->argv;
 	if (!argc) {
-		results = cmd_results_new(CMD_SUCCESS, NULL, NULL);
-		goto cleanup;
+		return cmd_results_new(CMD_SUCCESS, NULL, NULL);
 	}
 
 	// Find handler for the command this is setting a policy for
@@ -593,22 +709,17 @@ struct cmd_results *config_commands_command(char *exec) {
 		context |= context_names[j].context;
 	}
 
-	struct command_policy *policy = NULL;
-	for (int i = 0; i < config->command_policies->length; ++i) {
-		struct command_policy *p = config->command_policies->items[i];
-		if (strcmp(p->command, cmd) == 0) {
-			policy = p;
-			break;
-		}
-	}
+	struct command_policy *policy = hash_get(config->command_policy_index, cmd);
 	if (!policy) {
 		policy = alloc_command_policy(cmd);
 		if (!policy) {
 			sway_abort("Unable to allocate security policy");
 		}
 		list_add(config->command_policies, policy);
+		hash_set(config->command_policy_index, policy->command, policy);
 	}
 	policy->context = context;
+	update_command_policies();
 
 	sway_log(L_INFO, "Set command policy for %s to %d",
 			policy->command, policy->context);
@@ -616,7 +727,6 @@ struct cmd_results *config_commands_command(char *exec) {
 	results = cmd_results_new(CMD_SUCCESS, NULL, NULL);
 
 cleanup:
-	free_argv(argc, argv);
 	return results;
 }
 
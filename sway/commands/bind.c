@@ -26,6 +26,7 @@ struct cmd_results *cmd_bindsym(int argc, char **argv) {
 	binding->modifiers = 0;
 	binding->release = false;
 	binding->bindcode = false;
+	binding->compiled = NULL;
 
 	// Handle --release
 	if (strcmp("--release", argv[0]) == 0) {
@@ -42,6 +43,7 @@ struct cmd_results *cmd_bindsym(int argc, char **argv) {
 	}
 
 	binding->command = join_args(argv + 1, argc - 1);
+	binding->compiled = compile_commands(binding->command, CONTEXT_BINDING);
 
 	list_t *split = split_string(argv[0], "+");
 	for (int i = 0; i < split->length; ++i) {
@@ -89,6 +91,7 @@ struct cmd_results *cmd_bindsym(int argc, char **argv) {
 	binding->order = binding_order++;
 	list_add(mode->bindings, binding);
 	list_qsort(mode->bindings, sway_binding_cmp_qsort);
+	free_binding_index(mode);
 
 	sway_log(L_DEBUG, "bindsym - Bound %s to command %s", argv[0], binding->command);
 	return cmd_results_new(CMD_SUCCESS, NULL, NULL);
@@ -109,6 +112,7 @@ struct cmd_results *cmd_bindcode(int argc, char **argv) {
 	binding->modifiers = 0;
 	binding->release = false;
 	binding->bindcode = true;
+	binding->compiled = NULL;
 
 	// Handle --release
 	if (strcmp("--release", argv[0]) == 0) {
@@ -125,6 +129,7 @@ struct cmd_results *cmd_bindcode(int argc, char **argv) {
 	}
 
 	binding->command = join_args(argv + 1, argc - 1);
+	binding->compiled = compile_commands(binding->command, CONTEXT_BINDING);
 
 	list_t *split = split_string(argv[0], "+");
 	for (int i = 0; i < split->length; ++i) {
@@ -163,6 +168,7 @@ struct cmd_results *cmd_bindcode(int argc, char **argv) {
 	binding->order = binding_order++;
 	list_add(mode->bindings, binding);
 	list_qsort(mode->bindings, sway_binding_cmp_qsort);
+	free_binding_index(mode);
 
 	sway_log(L_DEBUG, "bindcode - Bound %s to command %s", argv[0], binding->command);
 	return cmd_results_new(CMD_SUCCESS, NULL, NULL);
@@ -74,12 +74,13 @@ struct cmd_results *cmd_exec_always(int argc, char **argv) {
 	if (*child > 0 && ws) {
 		sway_log(L_DEBUG, "Child process created with pid %d for workspace %s", *child, ws->name);
 		struct pid_workspace *pw = malloc(sizeof(struct pid_workspace));
-		pw->pid = child;
-		pw->workspace = strdup(ws->name);
-		pid_workspace_add(pw);
-	} else {
-		free(child);
+		if (pw) {
+			pw->pid = *child;
+			pw->workspace = strdup(ws->name);
+			pid_workspace_add(pw);
+		}
 	}
+	free(child);
 
 	return cmd_results_new(CMD_SUCCESS, NULL, NULL);
 }
@@ -38,6 +38,10 @@ struct cmd_results *cmd_ipc(int argc, char **argv) {
 
 	current_policy = alloc_ipc_policy(program);
 	list_add(config->ipc_policies, current_policy);
+	// the first policy for a program takes precedence
+	if (current_policy && !hash_contains(config->ipc_policy_index, current_policy->program)) {
+		hash_set(config->ipc_policy_index, current_policy->program, current_policy);
+	}
 
 	free(program);
 	return cmd_results_new(CMD_BLOCK_IPC, NULL, NULL);
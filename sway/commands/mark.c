@@ -5,15 +5,6 @@
 #include "list.h"
 #include "stringop.h"
 
-static void find_marks_callback(swayc_t *container, void *_mark) {
-	char *mark = (char *)_mark;
-
-	int index;
-	if (container->marks && ((index = list_seq_find(container->marks, (int (*)(const void *, const void *))strcmp, mark)) != -1)) {
-		list_del(container->marks, index);
-	}
-}
-
 struct cmd_results *cmd_mark(int argc, char **argv) {
 	struct cmd_results *error = NULL;
 	if (config->reading) return cmd_results_new(CMD_FAILURE, "mark", "Can't be used in config file.");
@@ -39,45 +30,21 @@ struct cmd_results *cmd_mark(int argc, char **argv) {
 
 	if (argc) {
 		char *mark = join_args(argv, argc);
+		bool marked = container_by_mark(mark) == view;
 
-		// Remove all existing marks of this type
-		container_map(&root_container, find_marks_callback, mark);
-
-		if (view->marks) {
+		if (toggle && marked) {
 			if (add) {
-				int index;
-				if ((index = list_seq_find(view->marks, (int (*)(const void *, const void *))strcmp, mark)) != -1) {
-					if (toggle) {
-						free(view->marks->items[index]);
-						list_del(view->marks, index);
-
-						if (0 == view->marks->length) {
-							list_free(view->marks);
-							view->marks = NULL;
-						}
-					}
-					free(mark);
-				} else {
-					list_add(view->marks, mark);
-				}
+				container_remove_mark(view, mark);
 			} else {
-				if (toggle && list_seq_find(view->marks, (int (*)(const void *, const void *))strcmp, mark) != -1) {
-					// Delete the list
-					list_foreach(view->marks, free);
-					list_free(view->marks);
-					view->marks = NULL;
-				} else {
-					// Delete and replace with a new list
-					list_foreach(view->marks, free);
-					list_free(view->marks);
-
-					view->marks = create_list();
-					list_add(view->marks, mark);
-				}
+				container_clear_marks(view);
 			}
+			free(mark);
 		} else {
-			view->marks = create_list();
-			list_add(view->marks, mark);
+			if (!add) {
+				container_clear_marks(view);
+			}
+			// Also removes the mark from any other container
+			container_add_mark(view, mark);
 		}
 	} else {
 		return cmd_results_new(CMD_FAILURE, "mark",
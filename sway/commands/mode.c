@@ -38,6 +38,8 @@ struct cmd_results *cmd_mode(int argc, char **argv) {
 		}
 		mode->name = strdup(mode_name);
 		mode->bindings = create_list();
+		mode->binding_index = NULL;
+		mode->workspace_names = NULL;
 		list_add(config->modes, mode);
 	}
 	if (!mode) {
@@ -173,10 +173,11 @@ struct cmd_results *cmd_output(int argc, char **argv) {
 			output->height, output->x, output->y, output->scale,
 			output->background, output->background_option);
 
-	if (output->name) {
+	if (output->name && !config->reloading) {
 		// Try to find the output container and apply configuration now. If
 		// this is during startup then there will be no container and config
-		// will be applied during normal "new output" event from wlc.
+		// will be applied during normal "new output" event from wlc. A reload
+		// applies what changed once the whole config has been read.
 		swayc_t *cont = NULL;
 		for (int i = 0; i < root_container.children->length; ++i) {
 			cont = root_container.children->items[i];
@@ -189,6 +190,7 @@ struct cmd_results *cmd_output(int argc, char **argv) {
 				}
 			}
 		}
+		load_swaybg();
 	}
 
 	return cmd_results_new(CMD_SUCCESS, NULL, NULL);
@@ -7,11 +7,22 @@
 #include "list.h"
 #include "stringop.h"
 
-// sort in order of longest->shortest
-static int compare_set_qsort(const void *_l, const void *_r) {
-	struct sway_variable const *l = *(void **)_l;
-	struct sway_variable const *r = *(void **)_r;
-	return strlen(r->name) - strlen(l->name);
+// Adds var to its bucket of config->symbol_index, keeping the bucket in
+// order of longest->shortest name
+static void index_variable(struct sway_variable *var) {
+	list_t **bucket = &config->symbol_index[(unsigned char)var->name[1]];
+	if (!*bucket) {
+		*bucket = create_list();
+	}
+	size_t len = strlen(var->name);
+	int i;
+	for (i = 0; i < (*bucket)->length; ++i) {
+		struct sway_variable *other = (*bucket)->items[i];
+		if (strlen(other->name) < len) {
+			break;
+		}
+	}
+	list_insert(*bucket, i, var);
 }
 
 struct cmd_results *cmd_set(int argc, char **argv) {
@@ -37,9 +48,10 @@ struct cmd_results *cmd_set(int argc, char **argv) {
 
 	struct sway_variable *var = NULL;
 	// Find old variable if it exists
+	list_t *bucket = config->symbol_index[(unsigned char)argv[0][1]];
 	int i;
-	for (i = 0; i < config->symbols->length; ++i) {
-		var = config->symbols->items[i];
+	for (i = 0; bucket && i < bucket->length; ++i) {
+		var = bucket->items[i];
 		if (strcmp(var->name, argv[0]) == 0) {
 			break;
 		}
@@ -54,7 +66,7 @@ struct cmd_results *cmd_set(int argc, char **argv) {
 		}
 		var->name = strdup(argv[0]);
 		list_add(config->symbols, var);
-		list_qsort(config->symbols, compare_set_qsort);
+		index_variable(var);
 	}
 	var->value = join_args(argv + 1, argc - 1);
 	return cmd_results_new(CMD_SUCCESS, NULL, NULL);
@@ -0,0 +1,18 @@
+#include <stdlib.h>
+#include "sway/commands.h"
+
+struct cmd_results *cmd_title_update_rate(int argc, char **argv) {
+	struct cmd_results *error = NULL;
+	if ((error = checkarg(argc, "title_update_rate", EXPECTED_EQUAL_TO, 1))) {
+		return error;
+	}
+
+	char *end;
+	long rate = strtol(argv[0], &end, 10);
+	if (*end || rate < 0) {
+		return cmd_results_new(CMD_INVALID, "title_update_rate",
+				"Expected a number of updates per second, or 0 for no limit");
+	}
+	config->title_update_rate = rate;
+	return cmd_results_new(CMD_SUCCESS, NULL, NULL);
+}
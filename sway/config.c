@@ -15,6 +15,8 @@
 #include <float.h>
 #include <dirent.h>
 #include <strings.h>
+#include <ctype.h>
+#include <pthread.h>
 #include "wayland-desktop-shell-server-protocol.h"
 #include "sway/commands.h"
 #include "sway/config.h"
@@ -23,7 +25,8 @@
 #include "sway/criteria.h"
 #include "sway/input.h"
 #include "sway/border.h"
-#include "readline.h"
+#include "sway/security.h"
+#include "sway/output.h"
 #include "stringop.h"
 #include "list.h"
 #include "log.h"
@@ -31,6 +34,7 @@
 struct sway_config *config = NULL;
 
 static void terminate_swaybar(pid_t pid);
+static void apply_config_changes(struct sway_config *old_config);
 
 static void free_variable(struct sway_variable *var) {
 	if (!var) {
@@ -47,6 +51,7 @@ static void free_binding(struct sway_binding *bind) {
 	}
 	free_flat_list(bind->keys);
 	free(bind->command);
+	free_compiled_commands(bind->compiled);
 	free(bind);
 }
 
@@ -60,6 +65,7 @@ static void free_mode(struct sway_mode *mode) {
 		free_binding(mode->bindings->items[i]);
 	}
 	list_free(mode->bindings);
+	free_binding_index(mode);
 	free(mode);
 }
 
@@ -136,6 +142,24 @@ static void free_workspace_output(struct workspace_output *wo) {
 	free(wo);
 }
 
+// pids are stored in the index as the key pointer itself
+#define PID_KEY(pid) ((void *)(intptr_t)(pid))
+
+struct pid_workspace *pid_workspace_find(pid_t pid) {
+	return hash_get(config->pid_workspace_index, PID_KEY(pid));
+}
+
+void pid_workspace_del(struct pid_workspace *pw) {
+	hash_del(config->pid_workspace_index, PID_KEY(pw->pid));
+	for (int i = config->pid_workspaces->length - 1; i > -1; i--) {
+		if (config->pid_workspaces->items[i] == pw) {
+			list_del(config->pid_workspaces, i);
+			break;
+		}
+	}
+	free_pid_workspace(pw);
+}
+
 static void pid_workspace_cleanup() {
 	struct timespec ts;
 	struct pid_workspace *pw = NULL;
@@ -147,8 +171,9 @@ static void pid_workspace_cleanup() {
 	for (int i = config->pid_workspaces->length - 1; i > -1; i--) {
 		pw = config->pid_workspaces->items[i];
 
-		if (difftime(ts.tv_sec, *pw->time_added) >= PID_WORKSPACE_TIMEOUT) {
-			free_pid_workspace(config->pid_workspaces->items[i]);
+		if (difftime(ts.tv_sec, pw->time_added) >= PID_WORKSPACE_TIMEOUT) {
+			hash_del(config->pid_workspace_index, PID_KEY(pw->pid));
+			free_pid_workspace(pw);
 			list_del(config->pid_workspaces, i);
 		}
 	}
@@ -156,43 +181,29 @@ static void pid_workspace_cleanup() {
 
 // de-dupe pid_workspaces to ensure pid uniqueness
 void pid_workspace_add(struct pid_workspace *pw) {
-	struct pid_workspace *list_pw = NULL;
 	struct timespec ts;
-	time_t *now = malloc(sizeof(time_t));
-	if (!now) {
-		sway_log(L_ERROR, "Allocating time for pid_workspace failed");
-		return;
-	}
 
 	pid_workspace_cleanup();
 
 	// add current time to pw
 	clock_gettime(CLOCK_MONOTONIC, &ts);
-	*now = ts.tv_sec;
-
-	pw->time_added = now;
+	pw->time_added = ts.tv_sec;
 
-	// work backwards through list and delete any entries that
-	// have the same pid as that in our new pid_workspace
-	for (int i = config->pid_workspaces->length - 1; i > -1; i--) {
-		list_pw = config->pid_workspaces->items[i];
-
-		if (pw->pid == list_pw->pid) {
-			free_pid_workspace(config->pid_workspaces->items[i]);
-			list_del(config->pid_workspaces, i);
-		}
+	// replace any entry that has the same pid as our new pid_workspace
+	struct pid_workspace *old = pid_workspace_find(pw->pid);
+	if (old) {
+		pid_workspace_del(old);
 	}
 
 	list_add(config->pid_workspaces, pw);
+	hash_set(config->pid_workspace_index, PID_KEY(pw->pid), pw);
 }
 
 void free_pid_workspace(struct pid_workspace *pw) {
 	if (!pw) {
 		return;
 	}
-	free(pw->pid);
 	free(pw->workspace);
-	free(pw->time_added);
 	free(pw);
 }
 
@@ -221,6 +232,9 @@ void free_config(struct sway_config *config) {
 		free_variable(config->symbols->items[i]);
 	}
 	list_free(config->symbols);
+	for (i = 0; i < (int)(sizeof(config->symbol_index) / sizeof(list_t *)); ++i) {
+		list_free(config->symbol_index[i]);
+	}
 
 	for (i = 0; config->modes && i < config->modes->length; ++i) {
 		free_mode(config->modes->items[i]);
@@ -232,7 +246,10 @@ void free_config(struct sway_config *config) {
 	}
 	list_free(config->bars);
 
-	free_flat_list(config->cmd_queue);
+	for (i = 0; config->cmd_queue && i < config->cmd_queue->length; ++i) {
+		free_compiled_commands(config->cmd_queue->items[i]);
+	}
+	list_free(config->cmd_queue);
 
 	for (i = 0; config->workspace_outputs && i < config->workspace_outputs->length; ++i) {
 		free_workspace_output(config->workspace_outputs->items[i]);
@@ -243,6 +260,7 @@ void free_config(struct sway_config *config) {
 		free_pid_workspace(config->pid_workspaces->items[i]);
 	}
 	list_free(config->pid_workspaces);
+	hash_free(config->pid_workspace_index);
 
 	for (i = 0; config->criteria && i < config->criteria->length; ++i) {
 		free_criteria(config->criteria->items[i]);
@@ -268,11 +286,14 @@ void free_config(struct sway_config *config) {
 		free_command_policy(config->command_policies->items[i]);
 	}
 	list_free(config->command_policies);
+	hash_free(config->command_policy_index);
 
 	for (i = 0; config->feature_policies && i < config->feature_policies->length; ++i) {
 		free_feature_policy(config->feature_policies->items[i]);
 	}
 	list_free(config->feature_policies);
+	hash_free(config->feature_policy_index);
+	hash_free(config->ipc_policy_index);
 
 	list_free(config->active_bar_modifiers);
 	free_flat_list(config->config_chain);
@@ -295,6 +316,7 @@ static void config_defaults(struct sway_config *config) {
 	if (!(config->bars = create_list())) goto cleanup;
 	if (!(config->workspace_outputs = create_list())) goto cleanup;
 	if (!(config->pid_workspaces = create_list())) goto cleanup;
+	if (!(config->pid_workspace_index = create_hash(hash_pointer, hash_pointer_cmp))) goto cleanup;
 	if (!(config->criteria = create_list())) goto cleanup;
 	if (!(config->no_focus = create_list())) goto cleanup;
 	if (!(config->input_configs = create_list())) goto cleanup;
@@ -306,6 +328,8 @@ static void config_defaults(struct sway_config *config) {
 	if (!(config->current_mode->name = malloc(sizeof("default")))) goto cleanup;
 	strcpy(config->current_mode->name, "default");
 	if (!(config->current_mode->bindings = create_list())) goto cleanup;
+	config->current_mode->binding_index = NULL;
+	config->current_mode->workspace_names = NULL;
 	list_add(config->modes, config->current_mode);
 
 	config->floating_mod = 0;
@@ -325,6 +349,7 @@ static void config_defaults(struct sway_config *config) {
 	config->floating_maximum_height = 0;
 	config->floating_minimum_width = 75;
 	config->floating_minimum_height = 50;
+	config->title_update_rate = 0;
 
 	// Flags
 	config->focus_follows_mouse = true;
@@ -391,6 +416,9 @@ static void config_defaults(struct sway_config *config) {
 	if (!(config->command_policies = create_list())) goto cleanup;
 	if (!(config->feature_policies = create_list())) goto cleanup;
 	if (!(config->ipc_policies = create_list())) goto cleanup;
+	if (!(config->command_policy_index = create_hash(hash_string, hash_string_cmp))) goto cleanup;
+	if (!(config->feature_policy_index = create_hash(hash_string, hash_string_cmp))) goto cleanup;
+	if (!(config->ipc_policy_index = create_hash(hash_string, hash_string_cmp))) goto cleanup;
 
 	return;
 cleanup:
@@ -465,28 +493,228 @@ static char *get_config_path(void) {
 
 const char *current_config_path;
 
-static bool load_config(const char *path, struct sway_config *config) {
+/**
+ * A config file that has been read and split into lines, but not run yet.
+ */
+struct config_file {
+	char *buffer;
+	list_t *lines;
+};
+
+static void free_config_file(struct config_file *file) {
+	if (!file) {
+		return;
+	}
+	for (int i = 0; file->lines && i < file->lines->length; ++i) {
+		struct config_line *line = file->lines->items[i];
+		free_argv(line->argc, line->argv);
+		free(line);
+	}
+	list_free(file->lines);
+	free(file->buffer);
+	free(file);
+}
+
+static char *read_file(FILE *f, size_t *length) {
+	size_t size = 4096;
+	char *buffer = malloc(size + 1);
+	*length = 0;
+	while (buffer) {
+		*length += fread(buffer + *length, 1, size - *length, f);
+		if (*length < size) {
+			break;
+		}
+		char *new_buffer = realloc(buffer, (size *= 2) + 1);
+		if (!new_buffer) {
+			free(buffer);
+			return NULL;
+		}
+		buffer = new_buffer;
+	}
+	if (buffer && ferror(f)) {
+		free(buffer);
+		return NULL;
+	}
+	return buffer;
+}
+
+static bool add_config_line(struct config_file *file, char *text, int number) {
+	text += strspn(text, " \t");
+	char *end = text + strlen(text);
+	while (end > text && (end[-1] == ' ' || end[-1] == '\t')) {
+		--end;
+	}
+	*end = '\0';
+	if (*text == '\0' || *text == '#') {
+		return true;
+	}
+	struct config_line *line = malloc(sizeof(struct config_line));
+	if (!line) {
+		return false;
+	}
+	line->number = number;
+	line->text = text;
+	line->argv = split_args(text, &line->argc);
+	list_add(file->lines, line);
+	return true;
+}
+
+/**
+ * Reads the whole file in one go and splits it into logical lines in place,
+ * following read_line: a backslash before the newline continues the line, \r
+ * is dropped and \0 ends a line. Each line is then tokenized once, so running
+ * it needs no further reading or splitting.
+ *
+ * This touches no global state and doesn't log, so it is safe to call from
+ * the threads of read_config_files. Returns NULL if the file can't be read.
+ */
+static struct config_file *read_config_file(const char *path) {
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		return NULL;
+	}
+	struct config_file *file = calloc(1, sizeof(struct config_file));
+	size_t length = 0;
+	if (!file || !(file->lines = create_list())
+			|| !(file->buffer = read_file(f, &length))) {
+		fclose(f);
+		free_config_file(file);
+		return NULL;
+	}
+	fclose(f);
+
+	char *buffer = file->buffer;
+	// Lines only ever shrink, so they are compacted into the buffer behind
+	// the read position
+	char *out = buffer, *start = buffer;
+	int number = 1, start_number = 1;
+	char last = '\0';
+	for (size_t i = 0; i <= length; ++i) {
+		char c = i < length ? buffer[i] : '\0';
+		if (c == '\n' && last == '\\') {
+			--out;
+			last = '\0';
+			++number;
+			continue;
+		}
+		if (c == '\n' || c == '\0') {
+			*out++ = '\0';
+			if (!add_config_line(file, start, start_number)) {
+				free_config_file(file);
+				return NULL;
+			}
+			if (c == '\n') {
+				++number;
+			}
+			start = out;
+			start_number = number;
+			last = '\0';
+			continue;
+		}
+		if (c == '\r') {
+			continue;
+		}
+		last = c;
+		*out++ = c;
+	}
+	return file;
+}
+
+// Upper bound for read_config_files, reading is mostly waiting for the disk
+#define CONFIG_READ_THREADS 8
+
+struct config_read_job {
+	list_t *paths;
+	struct config_file **files;
+	int next;
+	pthread_mutex_t lock;
+};
+
+static void *config_read_worker(void *data) {
+	struct config_read_job *job = data;
+	while (true) {
+		pthread_mutex_lock(&job->lock);
+		int i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+		if (i >= job->paths->length) {
+			return NULL;
+		}
+		job->files[i] = read_config_file(job->paths->items[i]);
+	}
+}
+
+/**
+ * Reads and tokenizes the files at the given paths on a pool of threads.
+ * Nothing is run: the caller runs the files, in the order of paths, on the
+ * main thread with load_config. The result has one entry per path, NULL where
+ * the file couldn't be read, and must be freed along with the files that
+ * were not passed on to load_config.
+ */
+static struct config_file **read_config_files(list_t *paths) {
+	struct config_read_job job = {
+		.paths = paths,
+		.files = calloc(paths->length ? paths->length : 1, sizeof(struct config_file *)),
+		.next = 0,
+	};
+	if (!job.files) {
+		return NULL;
+	}
+	// The calling thread reads as well
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads > CONFIG_READ_THREADS) {
+		threads = CONFIG_READ_THREADS;
+	}
+	if (threads > paths->length) {
+		threads = paths->length;
+	}
+	pthread_t workers[CONFIG_READ_THREADS];
+	int started = 0;
+	pthread_mutex_init(&job.lock, NULL);
+	while (started < threads - 1) {
+		if (pthread_create(&workers[started], NULL, config_read_worker, &job) != 0) {
+			sway_log(L_DEBUG, "Unable to start config reader thread");
+			break;
+		}
+		++started;
+	}
+	config_read_worker(&job);
+	for (int i = 0; i < started; ++i) {
+		pthread_join(workers[i], NULL);
+	}
+	pthread_mutex_destroy(&job.lock);
+	return job.files;
+}
+
+static bool run_config_file(struct config_file *file, struct sway_config *config);
+
+/**
+ * Runs the config file at path. file is what read_config_files read from it,
+ * or NULL to read it now. Takes ownership of file.
+ */
+static bool load_config(const char *path, struct sway_config *config, struct config_file *file) {
 	sway_log(L_INFO, "Loading config from %s", path);
 	current_config_path = path;
 
 	struct stat sb;
 	if (stat(path, &sb) == 0 && S_ISDIR(sb.st_mode)) {
+		free_config_file(file);
 		return false;
 	}
 
 	if (path == NULL) {
 		sway_log(L_ERROR, "Unable to find a config file!");
+		free_config_file(file);
 		return false;
 	}
 
-	FILE *f = fopen(path, "r");
-	if (!f) {
-		sway_log(L_ERROR, "Unable to open %s for reading", path);
+	if (!file && !(file = read_config_file(path))) {
+		sway_log(L_ERROR, "Unable to read %s", path);
+		current_config_path = NULL;
 		return false;
 	}
 
-	bool config_load_success = read_config(f, config);
-	fclose(f);
+	bool config_load_success = run_config_file(file, config);
+	free_config_file(file);
 
 	if (!config_load_success) {
 		sway_log(L_ERROR, "Error(s) loading config!");
@@ -517,6 +745,7 @@ bool load_main_config(const char *file, bool is_active) {
 	}
 
 	config_defaults(config);
+	update_command_policies();
 	if (is_active) {
 		sway_log(L_DEBUG, "Performing configuration file reload");
 		config->reloading = true;
@@ -530,12 +759,14 @@ bool load_main_config(const char *file, bool is_active) {
 	
 	// Read security configs
 	bool success = true;
+	list_t *secconfigs = create_list();
+	// The security configs that get loaded, followed by the main config
+	list_t *paths = create_list();
 	DIR *dir = opendir(SYSCONFDIR "/sway/security.d");
 	if (!dir) {
 		sway_log(L_ERROR, "%s does not exist, sway will have no security configuration"
 				" and will probably be broken", SYSCONFDIR "/sway/security.d");
 	} else {
-		list_t *secconfigs = create_list();
 		char *base = SYSCONFDIR "/sway/security.d/";
 		struct dirent *ent = readdir(dir);
 		struct stat s;
@@ -557,46 +788,70 @@ bool load_main_config(const char *file, bool is_active) {
 			if (stat(_path, &s) || s.st_uid != 0 || s.st_gid != 0 || (((s.st_mode & 0777) != 0644) && (s.st_mode & 0777) != 0444)) {
 				sway_log(L_ERROR, "Refusing to load %s - it must be owned by root and mode 644 or 444", _path);
 				success = false;
-			} else {
-				success = success && load_config(_path, config);
+			} else if (success) {
+				// Nothing after a refused config is loaded
+				list_add(paths, _path);
 			}
 		}
+	}
+	if (success && path) {
+		list_add(paths, path);
+	}
 
-		free_flat_list(secconfigs);
+	// Read and tokenize everything up front, then run it in order
+	struct config_file **files = read_config_files(paths);
+	for (int i = 0; i < paths->length; ++i) {
+		struct config_file *file = files ? files[i] : NULL;
+		if (success) {
+			success = load_config(paths->items[i], config, file);
+		} else {
+			free_config_file(file);
+		}
+	}
+	if (success && !path) {
+		success = load_config(path, config, NULL);
 	}
+	free(files);
+	list_free(paths);
+	free_flat_list(secconfigs);
 
-	success = success && load_config(path, config);
+	config->reading = false;
+	invalidate_policy_cache();
 
 	if (is_active) {
+		apply_config_changes(old_config);
 		config->reloading = false;
 	}
 
 	if (old_config) {
 		free_config(old_config);
 	}
-	config->reading = false;
 
 	if (success) {
 		update_active_bar_modifiers();
+		for (int i = 0; i < config->modes->length; ++i) {
+			build_binding_index(config->modes->items[i]);
+		}
 	}
 
 	return success;
 }
 
-static bool load_include_config(const char *path, const char *parent_dir, struct sway_config *config) {
-	// save parent config
-	const char *parent_config = config->current_config;
-
-	char *full_path = strdup(path);
+// Returns the real path of an included config, relative paths are relative
+// to the directory of the config including it
+static char *include_real_path(const char *path, const char *parent_dir) {
+	char *full_path;
 	int len = strlen(path);
 	if (len >= 1 && path[0] != '/') {
 		len = len + strlen(parent_dir) + 2;
 		full_path = malloc(len * sizeof(char));
 		if (!full_path) {
 			sway_log(L_ERROR, "Unable to allocate full path to included config");
-			return false;
+			return NULL;
 		}
 		snprintf(full_path, len, "%s/%s", parent_dir, path);
+	} else {
+		full_path = strdup(path);
 	}
 
 	char *real_path = realpath(full_path, NULL);
@@ -604,8 +859,14 @@ static bool load_include_config(const char *path, const char *parent_dir, struct
 
 	if (real_path == NULL) {
 		sway_log(L_DEBUG, "%s not found.", path);
-		return false;
 	}
+	return real_path;
+}
+
+// Takes ownership of real_path and file, see load_config
+static bool load_include_config(char *real_path, struct config_file *file, struct sway_config *config) {
+	// save parent config
+	const char *parent_config = config->current_config;
 
 	// check if config has already been included
 	int j;
@@ -614,6 +875,7 @@ static bool load_include_config(const char *path, const char *parent_dir, struct
 		if (strcmp(real_path, old_path) == 0) {
 			sway_log(L_DEBUG, "%s already included once, won't be included again.", real_path);
 			free(real_path);
+			free_config_file(file);
 			return false;
 		}
 	}
@@ -622,7 +884,7 @@ static bool load_include_config(const char *path, const char *parent_dir, struct
 	list_add(config->config_chain, real_path);
 	int index = config->config_chain->length - 1;
 
-	if (!load_config(real_path, config)) {
+	if (!load_config(real_path, config, file)) {
 		free(real_path);
 		config->current_config = parent_config;
 		list_del(config->config_chain, index);
@@ -654,10 +916,21 @@ bool load_include_configs(const char *path, struct sway_config *config) {
 	}
 
 	char **w = p.we_wordv;
+	list_t *paths = create_list();
 	size_t i;
 	for (i = 0; i < p.we_wordc; ++i) {
-		load_include_config(w[i], parent_dir, config);
+		char *real_path = include_real_path(w[i], parent_dir);
+		if (real_path) {
+			list_add(paths, real_path);
+		}
+	}
+	// Read and tokenize all matches up front, then run them in order
+	struct config_file **files = read_config_files(paths);
+	for (int j = 0; j < paths->length; ++j) {
+		load_include_config(paths->items[j], files ? files[j] : NULL, config);
 	}
+	free(files);
+	list_free(paths);
 	free(parent_path);
 	wordfree(&p);
 
@@ -681,29 +954,20 @@ struct cmd_results *check_security_config() {
 	return NULL;
 }
 
-bool read_config(FILE *file, struct sway_config *config) {
+static bool run_config_file(struct config_file *file, struct sway_config *config) {
 	bool success = true;
 	enum cmd_status block = CMD_BLOCK_END;
 
-	int line_number = 0;
-	char *line;
-	while (!feof(file)) {
-		line = read_line(file);
-		if (!line) {
-			continue;
-		}
-		line_number++;
-		line = strip_whitespace(line);
-		if (line[0] == '#') {
-			free(line);
-			continue;
-		}
+	for (int i = 0; i < file->lines->length; ++i) {
+		struct config_line *cline = file->lines->items[i];
+		int line_number = cline->number;
+		char *line = cline->text;
 		struct cmd_results *res;
 		if (block == CMD_BLOCK_COMMANDS) {
 			// Special case
-			res = config_commands_command(line);
+			res = config_commands_command(cline);
 		} else {
-			res = config_command(line, block);
+			res = config_command(cline, block);
 		}
 		switch(res->status) {
 		case CMD_FAILURE:
@@ -714,9 +978,20 @@ bool read_config(FILE *file, struct sway_config *config) {
 			break;
 
 		case CMD_DEFER:
+		{
 			sway_log(L_DEBUG, "Defferring command `%s'", line);
-			list_add(config->cmd_queue, strdup(line));
+			char *command = do_var_replacement(strdup(line));
+			struct compiled_commands *commands = compile_commands(command, CONTEXT_CONFIG);
+			free(command);
+			if (commands) {
+				list_add(config->cmd_queue, commands);
+			} else {
+				sway_log(L_ERROR, "Unable to defer line %i '%s' (%s)", line_number, line,
+						config->current_config);
+				success = false;
+			}
 			break;
+		}
 
 		case CMD_BLOCK_MODE:
 			if (block == CMD_BLOCK_END) {
@@ -822,7 +1097,6 @@ bool read_config(FILE *file, struct sway_config *config) {
 			}
 		default:;
 		}
-		free(line);
 		free_cmd_results(res);
 	}
 
@@ -992,14 +1266,76 @@ static void terminate_swaybar(pid_t pid) {
 	}
 }
 
-void terminate_swaybg(pid_t pid) {
-	int ret = kill(pid, SIGTERM);
+static pid_t swaybg_pid = 0;
+// Arguments of the running swaybg, used to tell whether it needs a restart
+static char *swaybg_args = NULL;
+
+void terminate_swaybg(void) {
+	free(swaybg_args);
+	swaybg_args = NULL;
+	if (swaybg_pid == 0) {
+		return;
+	}
+	int ret = kill(swaybg_pid, SIGTERM);
 	if (ret != 0) {
-		sway_log(L_ERROR, "Unable to terminate swaybg [pid: %d]", pid);
+		sway_log(L_ERROR, "Unable to terminate swaybg [pid: %d]", swaybg_pid);
 	} else {
 		int status;
-		waitpid(pid, &status, 0);
+		waitpid(swaybg_pid, &status, 0);
+	}
+	swaybg_pid = 0;
+}
+
+void load_swaybg(void) {
+	// swaybg takes an <output index> <background> <mode> triple per output
+	list_t *args = create_list();
+	list_add(args, "swaybg");
+	size_t len = 0;
+	int i;
+	for (i = 0; i < root_container.children->length; ++i) {
+		swayc_t *output = root_container.children->items[i];
+		if (!output->background) {
+			continue;
+		}
+		char *output_id = malloc(12);
+		snprintf(output_id, 12, "%d", i);
+		list_add(args, output_id);
+		list_add(args, output->background);
+		list_add(args, output->background_option);
+		len += strlen(output_id) + strlen(output->background)
+			+ strlen(output->background_option) + 3;
+	}
+
+	char *joined = calloc(1, len + 1);
+	for (i = 1; i < args->length; ++i) {
+		strcat(joined, args->items[i]);
+		strcat(joined, "\n");
+	}
+
+	if (swaybg_args && strcmp(joined, swaybg_args) == 0) {
+		sway_log(L_DEBUG, "Backgrounds unchanged, keeping swaybg");
+		free(joined);
+	} else {
+		terminate_swaybg();
+		if (args->length > 1) {
+			sway_log(L_DEBUG, "Setting backgrounds for %d outputs", (args->length - 1) / 3);
+			list_add(args, NULL);
+			swaybg_pid = fork();
+			if (swaybg_pid == 0) {
+				execvp(args->items[0], (char * const *)args->items);
+				_exit(EXIT_FAILURE);
+			}
+			args->length--;
+			swaybg_args = joined;
+		} else {
+			free(joined);
+		}
 	}
+
+	for (i = 1; i < args->length; i += 3) {
+		free(args->items[i]);
+	}
+	list_free(args);
 }
 
 static bool active_output(const char *name) {
@@ -1015,7 +1351,7 @@ static bool active_output(const char *name) {
 	return false;
 }
 
-void load_swaybars() {
+static void spawn_swaybars(bool restart) {
 	// Check for bars
 	list_t *bars = create_list();
 	struct bar_config *bar = NULL;
@@ -1043,6 +1379,9 @@ void load_swaybars() {
 	for (i = 0; i < bars->length; ++i) {
 		bar = bars->items[i];
 		if (bar->pid != 0) {
+			if (!restart) {
+				continue;
+			}
 			terminate_swaybar(bar->pid);
 		}
 		sway_log(L_DEBUG, "Invoking swaybar for bar id '%s'", bar->id);
@@ -1052,6 +1391,218 @@ void load_swaybars() {
 	list_free(bars);
 }
 
+void load_swaybars() {
+	spawn_swaybars(true);
+}
+
+static bool strings_equal(list_t *a, list_t *b) {
+	if (!a || !b) {
+		return a == b;
+	}
+	if (a->length != b->length) {
+		return false;
+	}
+	for (int i = 0; i < a->length; ++i) {
+		if (strcmp(a->items[i], b->items[i]) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Compares bar a of old_config to bar b of the current config. Bars without
+ * a font of their own are sent the global font, so that is compared too.
+ */
+static bool bar_config_equal(struct sway_config *old_config,
+		struct bar_config *a, struct bar_config *b) {
+	char *font_a = a->font ? a->font : old_config->font;
+	char *font_b = b->font ? b->font : config->font;
+	if (a->modifier != b->modifier
+			|| a->position != b->position
+			|| a->pango_markup != b->pango_markup
+			|| a->height != b->height
+			|| a->tray_padding != b->tray_padding
+			|| a->workspace_buttons != b->workspace_buttons
+			|| a->wrap_scroll != b->wrap_scroll
+			|| a->strip_workspace_numbers != b->strip_workspace_numbers
+			|| a->binding_mode_indicator != b->binding_mode_indicator
+			|| a->verbose != b->verbose
+			|| lenient_strcmp(a->mode, b->mode) != 0
+			|| lenient_strcmp(a->hidden_state, b->hidden_state) != 0
+			|| lenient_strcmp(a->status_command, b->status_command) != 0
+			|| lenient_strcmp(a->swaybar_command, b->swaybar_command) != 0
+			|| lenient_strcmp(font_a, font_b) != 0
+			|| lenient_strcmp(a->separator_symbol, b->separator_symbol) != 0
+			|| !strings_equal(a->outputs, b->outputs)) {
+		return false;
+	}
+	if (a->bindings->length != b->bindings->length) {
+		return false;
+	}
+	for (int i = 0; i < a->bindings->length; ++i) {
+		struct sway_mouse_binding *ba = a->bindings->items[i];
+		struct sway_mouse_binding *bb = b->bindings->items[i];
+		if (ba->button != bb->button || lenient_strcmp(ba->command, bb->command) != 0) {
+			return false;
+		}
+	}
+	// colors is nothing but strings
+	char **colors_a = (char **)&a->colors, **colors_b = (char **)&b->colors;
+	for (size_t i = 0; i < sizeof(a->colors) / sizeof(char *); ++i) {
+		if (lenient_strcmp(colors_a[i], colors_b[i]) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static struct bar_config *find_bar_config(struct sway_config *config, const char *id) {
+	for (int i = 0; i < config->bars->length; ++i) {
+		struct bar_config *bar = config->bars->items[i];
+		if (strcmp(bar->id, id) == 0) {
+			return bar;
+		}
+	}
+	return NULL;
+}
+
+static struct output_config *find_output_config(struct sway_config *config, const char *name) {
+	for (int i = 0; i < config->output_configs->length; ++i) {
+		struct output_config *oc = config->output_configs->items[i];
+		if (strcasecmp(oc->name, name) == 0) {
+			return oc;
+		}
+	}
+	return NULL;
+}
+
+static bool output_config_equal(struct output_config *a, struct output_config *b) {
+	if (!a || !b) {
+		return a == b;
+	}
+	return a->enabled == b->enabled
+		&& a->width == b->width && a->height == b->height
+		&& a->x == b->x && a->y == b->y
+		&& a->scale == b->scale
+		&& lenient_strcmp(a->background, b->background) == 0
+		&& lenient_strcmp(a->background_option, b->background_option) == 0;
+}
+
+static bool input_config_equal(struct input_config *a, struct input_config *b) {
+	return a->accel_profile == b->accel_profile
+		&& a->click_method == b->click_method
+		&& a->drag_lock == b->drag_lock
+		&& a->dwt == b->dwt
+		&& a->left_handed == b->left_handed
+		&& a->middle_emulation == b->middle_emulation
+		&& a->natural_scroll == b->natural_scroll
+		&& a->pointer_accel == b->pointer_accel
+		&& a->scroll_method == b->scroll_method
+		&& a->send_events == b->send_events
+		&& a->tap == b->tap
+		&& a->capturable == b->capturable
+		&& memcmp(&a->region, &b->region, sizeof(a->region)) == 0;
+}
+
+// Whether settings that existing containers are laid out or drawn with differ
+static bool layout_config_changed(struct sway_config *a, struct sway_config *b) {
+	return a->gaps_inner != b->gaps_inner
+		|| a->gaps_outer != b->gaps_outer
+		|| a->edge_gaps != b->edge_gaps
+		|| a->smart_gaps != b->smart_gaps
+		|| a->border != b->border
+		|| a->floating_border != b->floating_border
+		|| a->border_thickness != b->border_thickness
+		|| a->floating_border_thickness != b->floating_border_thickness
+		|| a->hide_edge_borders != b->hide_edge_borders
+		|| a->show_marks != b->show_marks
+		|| strcmp(a->font, b->font) != 0
+		|| memcmp(&a->border_colors, &b->border_colors, sizeof(a->border_colors)) != 0;
+}
+
+/**
+ * Applies a reloaded config on top of the running session. Only what differs
+ * from old_config is touched: bars with an unchanged configuration keep their
+ * swaybar, outputs and inputs are only reconfigured if their config changed,
+ * swaybg is only restarted if a background changed and the tree is only
+ * rearranged if something it is laid out with changed.
+ */
+static void apply_config_changes(struct sway_config *old_config) {
+	int i;
+	for (i = 0; i < config->bars->length; ++i) {
+		struct bar_config *bar = config->bars->items[i];
+		struct bar_config *old = find_bar_config(old_config, bar->id);
+		if (old && old->pid != 0 && bar_config_equal(old_config, old, bar)) {
+			sway_log(L_DEBUG, "Bar %s unchanged, keeping swaybar", bar->id);
+			bar->pid = old->pid;
+			old->pid = 0;
+		}
+	}
+	// Bars that were not kept are terminated along with old_config
+	for (i = 0; i < old_config->bars->length; ++i) {
+		struct bar_config *old = old_config->bars->items[i];
+		if (old->pid != 0) {
+			terminate_swaybar(old->pid);
+			old->pid = 0;
+		}
+	}
+	spawn_swaybars(false);
+
+	bool relayout = layout_config_changed(old_config, config);
+	// Outputs may be destroyed by their config, go backwards
+	for (i = root_container.children->length - 1; i >= 0; --i) {
+		swayc_t *output = root_container.children->items[i];
+		if (output->type != C_OUTPUT || !output->name) {
+			continue;
+		}
+		struct output_config *oc = find_output_config(config, output->name);
+		struct output_config *all = find_output_config(config, "*");
+		if (output_config_equal(oc, find_output_config(old_config, output->name))
+				&& output_config_equal(all, find_output_config(old_config, "*"))) {
+			continue;
+		}
+		if (!oc) {
+			oc = all;
+		}
+		if (oc) {
+			sway_log(L_DEBUG, "Output config for %s changed", output->name);
+			apply_output_config(oc, output);
+			relayout = true;
+		}
+	}
+	load_swaybg();
+
+	for (i = 0; i < config->input_configs->length; ++i) {
+		struct input_config *ic = config->input_configs->items[i];
+		int j = list_seq_find(old_config->input_configs, input_identifier_cmp, ic->identifier);
+		if (j < 0 || !input_config_equal(ic, old_config->input_configs->items[j])) {
+			sway_log(L_DEBUG, "Input config for %s changed", ic->identifier);
+			apply_input_config_by_identifier(ic);
+		}
+	}
+
+	if (relayout) {
+		arrange_windows(&root_container, -1, -1);
+	}
+}
+
+void apply_input_config_by_identifier(struct input_config *ic) {
+	for (int i = 0; i < input_devices->length; ++i) {
+		struct libinput_device *device = input_devices->items[i];
+		char *dev_identifier = libinput_dev_unique_id(device);
+		if (!dev_identifier) {
+			continue;
+		}
+		bool match = strcmp(dev_identifier, ic->identifier) == 0;
+		free(dev_identifier);
+		if (match) {
+			apply_input_config(ic, device);
+			break;
+		}
+	}
+}
+
 void apply_input_config(struct input_config *ic, struct libinput_device *dev) {
 	if (!ic) {
 		return;
@@ -1110,6 +1661,7 @@ void apply_output_config(struct output_config *oc, swayc_t *output) {
 		destroy_output(output);
 		return;
 	}
+	invalidate_output_neighbors();
 
 	if (oc && oc->width > 0 && oc->height > 0) {
 		output->width = oc->width;
@@ -1141,52 +1693,45 @@ void apply_output_config(struct output_config *oc, swayc_t *output) {
 		output->x = x;
 	}
 
+	if ((!oc || !oc->background) && output->name) {
+		// Look for the output's own config for background
+		int i = list_seq_find(config->output_configs, output_name_cmp, output->name);
+		oc = i >= 0 ? config->output_configs->items[i] : NULL;
+	}
 	if (!oc || !oc->background) {
 		// Look for a * config for background
 		int i = list_seq_find(config->output_configs, output_name_cmp, "*");
-		if (i >= 0) {
-			oc = config->output_configs->items[i];
-		} else {
-			oc = NULL;
-		}
+		oc = i >= 0 ? config->output_configs->items[i] : NULL;
 	}
 
-	int output_i;
-	for (output_i = 0; output_i < root_container.children->length; ++output_i) {
-		if (root_container.children->items[output_i] == output) {
-			break;
-		}
+	free(output->background);
+	free(output->background_option);
+	output->background = NULL;
+	output->background_option = NULL;
+	if (oc && oc->background && oc->background_option) {
+		sway_log(L_DEBUG, "Setting background for output %s to %s", output->name, oc->background);
+		output->background = strdup(oc->background);
+		output->background_option = strdup(oc->background_option);
 	}
+}
 
-	if (oc && oc->background) {
-		if (output->bg_pid != 0) {
-			terminate_swaybg(output->bg_pid);
-		}
-
-		sway_log(L_DEBUG, "Setting background for output %d to %s", output_i, oc->background);
-
-		size_t bufsize = 12;
-		char output_id[bufsize];
-		snprintf(output_id, bufsize, "%d", output_i);
-		output_id[bufsize-1] = 0;
-
-		char *const cmd[] = {
-			"swaybg",
-			output_id,
-			oc->background,
-			oc->background_option,
-			NULL,
-		};
-
-		output->bg_pid = fork();
-		if (output->bg_pid == 0) {
-			execvp(cmd[0], cmd);
+static struct sway_variable *find_variable(const char *str) {
+	// str starts with $, only variables sharing the next character can match
+	list_t *candidates = config->symbol_index[(unsigned char)str[1]];
+	for (int i = 0; candidates && i < candidates->length; ++i) {
+		struct sway_variable *var = candidates->items[i];
+		if (strncmp(str, var->name, strlen(var->name)) == 0) {
+			return var;
 		}
 	}
+	// A variable named just $ matches anything
+	if (str[1] && (candidates = config->symbol_index[0]) && candidates->length) {
+		return candidates->items[0];
+	}
+	return NULL;
 }
 
 char *do_var_replacement(char *str) {
-	int i;
 	char *find = str;
 	while ((find = strchr(find, '$'))) {
 		// Skip if escaped.
@@ -1197,33 +1742,30 @@ char *do_var_replacement(char *str) {
 			}
 		}
 		// Find matching variable
-		for (i = 0; i < config->symbols->length; ++i) {
-			struct sway_variable *var = config->symbols->items[i];
-			int vnlen = strlen(var->name);
-			if (strncmp(find, var->name, vnlen) == 0) {
-				int vvlen = strlen(var->value);
-				char *newstr = malloc(strlen(str) - vnlen + vvlen + 1);
-				if (!newstr) {
-					sway_log(L_ERROR,
-							"Unable to allocate replacement during variable expansion");
-					break;
-				}
-				char *newptr = newstr;
-				int offset = find - str;
-				strncpy(newptr, str, offset);
-				newptr += offset;
-				strncpy(newptr, var->value, vvlen);
-				newptr += vvlen;
-				strcpy(newptr, find + vnlen);
-				free(str);
-				str = newstr;
-				find = str + offset + vvlen;
-				break;
-			}
+		struct sway_variable *var = find_variable(find);
+		if (!var) {
+			++find;
+			continue;
 		}
-		if (i == config->symbols->length) {
+		int vnlen = strlen(var->name);
+		int vvlen = strlen(var->value);
+		char *newstr = malloc(strlen(str) - vnlen + vvlen + 1);
+		if (!newstr) {
+			sway_log(L_ERROR,
+					"Unable to allocate replacement during variable expansion");
 			++find;
+			continue;
 		}
+		char *newptr = newstr;
+		int offset = find - str;
+		strncpy(newptr, str, offset);
+		newptr += offset;
+		strncpy(newptr, var->value, vvlen);
+		newptr += vvlen;
+		strcpy(newptr, find + vnlen);
+		free(str);
+		str = newstr;
+		find = str + offset + vvlen;
 	}
 	return str;
 }
@@ -1236,65 +1778,6 @@ int workspace_output_cmp_workspace(const void *a, const void *b) {
 	return lenient_strcmp(wsa->workspace, wsb->workspace);
 }
 
-int sway_binding_cmp_keys(const void *a, const void *b) {
-	const struct sway_binding *binda = a, *bindb = b;
-
-	// Count keys pressed for this binding. important so we check long before
-	// short ones.  for example mod+a+b  before  mod+a
-	unsigned int moda = 0, modb = 0, i;
-
-	// Count how any modifiers are pressed
-	for (i = 0; i < 8 * sizeof(binda->modifiers); ++i) {
-		moda += (binda->modifiers & 1 << i) != 0;
-		modb += (bindb->modifiers & 1 << i) != 0;
-	}
-	if (bindb->keys->length + modb != binda->keys->length + moda) {
-		return (bindb->keys->length + modb) - (binda->keys->length + moda);
-	}
-
-	// Otherwise compare keys
-	if (binda->modifiers > bindb->modifiers) {
-		return 1;
-	} else if (binda->modifiers < bindb->modifiers) {
-		return -1;
-	}
-	struct wlc_modifiers no_mods = { 0, 0 };
-	for (int i = 0; i < binda->keys->length; i++) {
-		xkb_keysym_t ka = *(xkb_keysym_t *)binda->keys->items[i],
-			kb = *(xkb_keysym_t *)bindb->keys->items[i];
-		if (binda->bindcode) {
-			uint32_t *keycode = binda->keys->items[i];
-			ka = wlc_keyboard_get_keysym_for_key(*keycode, &no_mods);
-		}
-
-		if (bindb->bindcode) {
-			uint32_t *keycode = bindb->keys->items[i];
-			kb = wlc_keyboard_get_keysym_for_key(*keycode, &no_mods);
-		}
-
-		if (ka > kb) {
-			return 1;
-		} else if (ka < kb) {
-			return -1;
-		}
-	}
-
-	return 0;
-}
-
-int sway_binding_cmp(const void *a, const void *b) {
-	int cmp = 0;
-	if ((cmp = sway_binding_cmp_keys(a, b)) != 0) {
-		return cmp;
-	}
-	const struct sway_binding *binda = a, *bindb = b;
-	return lenient_strcmp(binda->command, bindb->command);
-}
-
-int sway_binding_cmp_qsort(const void *a, const void *b) {
-	return sway_binding_cmp(*(void **)a, *(void **)b);
-}
-
 void free_sway_binding(struct sway_binding *binding) {
 	if (binding->keys) {
 		for (int i = 0; i < binding->keys->length; i++) {
@@ -1305,6 +1788,7 @@ void free_sway_binding(struct sway_binding *binding) {
 	if (binding->command) {
 		free(binding->command);
 	}
+	free_compiled_commands(binding->compiled);
 	free(binding);
 }
 
@@ -1348,6 +1832,7 @@ struct sway_binding *sway_binding_dup(struct sway_binding *sb) {
 	new_sb->order = sb->order;
 	new_sb->modifiers = sb->modifiers;
 	new_sb->command = strdup(sb->command);
+	new_sb->compiled = NULL;
 
 	new_sb->keys = create_list();
 	int i;
@@ -13,6 +13,8 @@
 #include "sway/input_state.h"
 #include "sway/ipc-server.h"
 #include "sway/output.h"
+#include "sway/criteria.h"
+#include "intern.h"
 #include "log.h"
 #include "stringop.h"
 
@@ -40,6 +42,8 @@ static swayc_t *new_swayc(enum swayc_types type) {
 	return c;
 }
 
+static void remove_hit_index(swayc_t *workspace);
+
 static void free_swayc(swayc_t *cont) {
 	if (!ASSERT_NONNULL(cont)) {
 		return;
@@ -61,27 +65,30 @@ static void free_swayc(swayc_t *cont) {
 		}
 		list_free(cont->floating);
 	}
-	if (cont->marks) {
-		list_foreach(cont->marks, free);
-		list_free(cont->marks);
-	}
+	container_clear_marks(cont);
 	if (cont->parent) {
 		remove_child(cont);
 	}
+	if (cont->type == C_VIEW) {
+		unindex_view(cont);
+	} else if (cont->type == C_WORKSPACE) {
+		unindex_workspace(cont);
+		remove_hit_index(cont);
+	} else if (cont->type == C_OUTPUT) {
+		invalidate_output_neighbors();
+	}
 	if (cont->name) {
 		free(cont->name);
 	}
-	if (cont->class) {
-		free(cont->class);
-	}
-	if (cont->instance) {
-		free(cont->instance);
-	}
-	if (cont->app_id) {
-		free(cont->app_id);
+	invalidate_container_index();
+	release_interned_string(cont->class);
+	release_interned_string(cont->instance);
+	release_interned_string(cont->app_id);
+	if (cont->background) {
+		free(cont->background);
 	}
-	if (cont->bg_pid != 0) {
-		terminate_swaybg(cont->bg_pid);
+	if (cont->background_option) {
+		free(cont->background_option);
 	}
 	if (cont->border) {
 		if (cont->border->buffer) {
@@ -169,11 +176,11 @@ swayc_t *new_output(wlc_handle handle) {
 	output->width = size.w;
 	output->height = size.h;
 	output->unmanaged = create_list();
-	output->bg_pid = 0;
 
 	apply_output_config(oc, output);
 	add_child(&root_container, output);
-	load_swaybars();
+	invalidate_output_neighbors();
+	schedule_output_settle(OUTPUT_ADDED);
 
 	// Create workspace
 	char *ws_name = NULL;
@@ -233,8 +240,8 @@ swayc_t *new_workspace(swayc_t *output, const char *name) {
 	workspace->visible = false;
 	workspace->floating = create_list();
 
-	add_child(output, workspace);
-	sort_workspaces(output);
+	insert_child(output, workspace, workspace_sort_index(output, workspace));
+	index_workspace(workspace);
 
 	return workspace;
 }
@@ -301,11 +308,12 @@ swayc_t *new_view(swayc_t *sibling, wlc_handle handle) {
 	view->handle = handle;
 	view->name = title ? strdup(title) : NULL;
 	const char *class = wlc_view_get_class(handle);
-	view->class = class ? strdup(class) : NULL;
+	view->class = class ? intern_string(class) : NULL;
 	const char *instance = wlc_view_get_instance(handle);
-	view->instance = instance ? strdup(instance) : NULL;
+	view->instance = instance ? intern_string(instance) : NULL;
 	const char *app_id = wlc_view_get_app_id(handle);
-	view->app_id = app_id ? strdup(app_id) : NULL;
+	view->app_id = app_id ? intern_string(app_id) : NULL;
+	index_view(view);
 	view->visible = true;
 	view->is_focused = true;
 	view->sticky = false;
@@ -341,11 +349,12 @@ swayc_t *new_floating_view(wlc_handle handle) {
 	view->handle = handle;
 	view->name = title ? strdup(title) : NULL;
 	const char *class = wlc_view_get_class(handle);
-	view->class = class ? strdup(class) : NULL;
+	view->class = class ? intern_string(class) : NULL;
 	const char *instance = wlc_view_get_instance(handle);
-	view->instance = instance ? strdup(instance) : NULL;
+	view->instance = instance ? intern_string(instance) : NULL;
 	const char *app_id = wlc_view_get_app_id(handle);
-	view->app_id = app_id ? strdup(app_id) : NULL;
+	view->app_id = app_id ? intern_string(app_id) : NULL;
+	index_view(view);
 	view->visible = true;
 	view->sticky = false;
 
@@ -380,6 +389,7 @@ swayc_t *new_floating_view(wlc_handle handle) {
 	// Case of focused workspace, just create as child of it
 	list_add(swayc_active_workspace()->floating, view);
 	view->parent = swayc_active_workspace();
+	invalidate_container_index();
 	if (swayc_active_workspace()->focused == NULL) {
 		set_focused_container_for(swayc_active_workspace(), view);
 	}
@@ -446,12 +456,12 @@ swayc_t *destroy_output(swayc_t *output) {
 			}
 			sort_workspaces(root_container.children->items[p]);
 			update_visibility(root_container.children->items[p]);
-			arrange_windows(root_container.children->items[p], -1, -1);
 		}
 	}
 	sway_log(L_DEBUG, "OUTPUT: Destroying output '%" PRIuPTR "'", output->handle);
 	free_swayc(output);
 	update_root_geometry();
+	schedule_output_settle(OUTPUT_REMOVED);
 	return &root_container;
 }
 
@@ -685,68 +695,338 @@ swayc_t *swayc_active_workspace_for(swayc_t *cont) {
 	}
 }
 
-static bool pointer_test(swayc_t *view, void *_origin) {
-	const struct wlc_point *origin = _origin;
-	// Determine the output that the view is under
-	swayc_t *parent = swayc_parent_by_type(view, C_OUTPUT);
-	if (origin->x >= view->x && origin->y >= view->y
-		&& origin->x < view->x + view->width && origin->y < view->y + view->height
-		&& view->visible && parent == root_container.focused) {
-		return true;
-	}
-	return false;
+/*
+ * Hit testing
+ *
+ * Each workspace keeps its hit-testable rectangles flattened into arrays, in
+ * the order a lookup has to prefer them, and bucketed into a grid over their
+ * bounding box. A lookup tests the few rectangles of one cell and never walks
+ * the tree. The index is rebuilt lazily the first time it is used after
+ * invalidate_container_index.
+ */
+
+#define HIT_GRID_SIZE 8
+
+struct hit_rect {
+	// width < 0 covers everything
+	double x, y, width, height;
+	swayc_t *container;
+	// depth in the tree and position in tree order, for sorting
+	int depth, order;
+};
+
+struct hit_grid {
+	int length, capacity;
+	struct hit_rect *rects;
+	double x, y, cell_width, cell_height;
+	// rects in cell i are cell_items[cell_start[i]] up to cell_start[i + 1]
+	int cell_start[HIT_GRID_SIZE * HIT_GRID_SIZE + 1];
+	int *cell_items;
+};
+
+struct hit_index {
+	unsigned int generation;
+	// what container_under_pointer finds, floating views first, then tiled
+	// containers deepest first
+	struct hit_grid containers;
+	// title bars in the order container_find would check them
+	struct hit_grid title_bars;
+};
+
+static hash_t *hit_indexes = NULL;
+static unsigned int hit_index_generation = 1;
+
+void invalidate_container_index(void) {
+	++hit_index_generation;
 }
 
-swayc_t *container_under_pointer(void) {
-	// root.output->workspace
-	if (!root_container.focused || !root_container.focused->focused) {
-		return NULL;
+static void hit_grid_reset(struct hit_grid *grid) {
+	grid->length = 0;
+	free(grid->cell_items);
+	grid->cell_items = NULL;
+}
+
+static void hit_grid_add(struct hit_grid *grid, swayc_t *container,
+		double x, double y, double width, double height, int depth) {
+	if (width == 0 || height <= 0) {
+		return;
 	}
-	swayc_t *lookup = root_container.focused->focused;
-	// Case of empty workspace
-	if (lookup->children == 0) {
-		return NULL;
+	if (grid->length == grid->capacity) {
+		int capacity = grid->capacity ? grid->capacity * 2 : 16;
+		struct hit_rect *rects = realloc(grid->rects, capacity * sizeof(struct hit_rect));
+		if (!rects) {
+			sway_log(L_ERROR, "Unable to grow hit test index");
+			return;
+		}
+		grid->rects = rects;
+		grid->capacity = capacity;
+	}
+	struct hit_rect *rect = &grid->rects[grid->length++];
+	rect->x = x;
+	rect->y = y;
+	rect->width = width;
+	rect->height = height;
+	rect->container = container;
+	rect->depth = depth;
+	rect->order = grid->length;
+}
+
+static void hit_rect_cells(const struct hit_grid *grid, const struct hit_rect *rect,
+		int *x0, int *y0, int *x1, int *y1) {
+	if (rect->width < 0) {
+		*x0 = *y0 = 0;
+		*x1 = *y1 = HIT_GRID_SIZE - 1;
+		return;
 	}
-	struct wlc_point origin;
-	wlc_pointer_get_position(&origin);
-	while (lookup && lookup->type != C_VIEW) {
-		int i;
-		int len;
-		// if tabbed/stacked go directly to focused container, otherwise search
-		// children
-		if (lookup->layout == L_TABBED || lookup->layout == L_STACKED) {
-			lookup = lookup->focused;
+	*x0 = (rect->x - grid->x) / grid->cell_width;
+	*y0 = (rect->y - grid->y) / grid->cell_height;
+	*x1 = (rect->x + rect->width - grid->x) / grid->cell_width;
+	*y1 = (rect->y + rect->height - grid->y) / grid->cell_height;
+	*x0 = *x0 < 0 ? 0 : *x0 >= HIT_GRID_SIZE ? HIT_GRID_SIZE - 1 : *x0;
+	*y0 = *y0 < 0 ? 0 : *y0 >= HIT_GRID_SIZE ? HIT_GRID_SIZE - 1 : *y0;
+	*x1 = *x1 < 0 ? 0 : *x1 >= HIT_GRID_SIZE ? HIT_GRID_SIZE - 1 : *x1;
+	*y1 = *y1 < 0 ? 0 : *y1 >= HIT_GRID_SIZE ? HIT_GRID_SIZE - 1 : *y1;
+}
+
+// Buckets the rects, which must already be in order of preference
+static void hit_grid_build(struct hit_grid *grid) {
+	double x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+	bool any = false;
+	for (int i = 0; i < grid->length; ++i) {
+		struct hit_rect *rect = &grid->rects[i];
+		if (rect->width < 0) {
 			continue;
 		}
-		// if workspace, search floating
-		if (lookup->type == C_WORKSPACE) {
-			i = len = lookup->floating->length;
-			bool got_floating = false;
-			while (--i > -1) {
-				if (pointer_test(lookup->floating->items[i], &origin)) {
-					lookup = lookup->floating->items[i];
-					got_floating = true;
-					break;
-				}
+		if (!any || rect->x < x0) {
+			x0 = rect->x;
+		}
+		if (!any || rect->y < y0) {
+			y0 = rect->y;
+		}
+		if (!any || rect->x + rect->width > x1) {
+			x1 = rect->x + rect->width;
+		}
+		if (!any || rect->y + rect->height > y1) {
+			y1 = rect->y + rect->height;
+		}
+		any = true;
+	}
+	grid->x = x0;
+	grid->y = y0;
+	grid->cell_width = x1 > x0 ? (x1 - x0) / HIT_GRID_SIZE : 1;
+	grid->cell_height = y1 > y0 ? (y1 - y0) / HIT_GRID_SIZE : 1;
+
+	// Count, then fill, each cell keeping the order of the rects
+	int counts[HIT_GRID_SIZE * HIT_GRID_SIZE] = { 0 };
+	int total = 0;
+	for (int i = 0; i < grid->length; ++i) {
+		int cx0, cy0, cx1, cy1;
+		hit_rect_cells(grid, &grid->rects[i], &cx0, &cy0, &cx1, &cy1);
+		for (int cy = cy0; cy <= cy1; ++cy) {
+			for (int cx = cx0; cx <= cx1; ++cx) {
+				counts[cy * HIT_GRID_SIZE + cx]++;
+				total++;
 			}
-			if (got_floating) {
-				continue;
+		}
+	}
+	grid->cell_start[0] = 0;
+	for (int i = 0; i < HIT_GRID_SIZE * HIT_GRID_SIZE; ++i) {
+		grid->cell_start[i + 1] = grid->cell_start[i] + counts[i];
+		counts[i] = grid->cell_start[i];
+	}
+	grid->cell_items = malloc((total ? total : 1) * sizeof(int));
+	if (!grid->cell_items) {
+		sway_log(L_ERROR, "Unable to allocate hit test grid");
+		grid->length = 0;
+		return;
+	}
+	for (int i = 0; i < grid->length; ++i) {
+		int cx0, cy0, cx1, cy1;
+		hit_rect_cells(grid, &grid->rects[i], &cx0, &cy0, &cx1, &cy1);
+		for (int cy = cy0; cy <= cy1; ++cy) {
+			for (int cx = cx0; cx <= cx1; ++cx) {
+				grid->cell_items[counts[cy * HIT_GRID_SIZE + cx]++] = i;
 			}
 		}
-		// search children
-		len = lookup->children->length;
-		for (i = 0; i < len; ++i) {
-			if (pointer_test(lookup->children->items[i], &origin)) {
-				lookup = lookup->children->items[i];
-				break;
+	}
+}
+
+static bool hit_rect_contains(const struct hit_rect *rect, const struct wlc_point *origin) {
+	return rect->width < 0 || (origin->x >= rect->x && origin->y >= rect->y
+			&& origin->x < rect->x + rect->width && origin->y < rect->y + rect->height);
+}
+
+static swayc_t *hit_grid_find(const struct hit_grid *grid, const struct wlc_point *origin) {
+	if (!grid->cell_items) {
+		return NULL;
+	}
+	int cx = (origin->x - grid->x) / grid->cell_width;
+	int cy = (origin->y - grid->y) / grid->cell_height;
+	if (origin->x < grid->x || origin->y < grid->y
+			|| cx >= HIT_GRID_SIZE || cy >= HIT_GRID_SIZE) {
+		// Outside of everything but the rects that cover everything
+		for (int i = 0; i < grid->length; ++i) {
+			if (grid->rects[i].width < 0) {
+				return grid->rects[i].container;
 			}
 		}
-		// when border and titles are done, this could happen
-		if (i == len) {
-			break;
+		return NULL;
+	}
+	int cell = cy * HIT_GRID_SIZE + cx;
+	for (int i = grid->cell_start[cell]; i < grid->cell_start[cell + 1]; ++i) {
+		const struct hit_rect *rect = &grid->rects[grid->cell_items[i]];
+		if (hit_rect_contains(rect, origin)) {
+			return rect->container;
+		}
+	}
+	return NULL;
+}
+
+static int hit_rect_depth_cmp(const void *_a, const void *_b) {
+	const struct hit_rect *a = _a, *b = _b;
+	if (a->depth != b->depth) {
+		return b->depth - a->depth;
+	}
+	// keep tree order between containers of the same depth
+	return a->order - b->order;
+}
+
+/*
+ * Adds the containers below container that container_under_pointer could
+ * descend to. A container it only reaches by following the focus of a tabbed
+ * or stacked parent, without testing its geometry, gets the area of its
+ * nearest tested ancestor.
+ */
+static void collect_containers(struct hit_grid *grid, swayc_t *container,
+		const struct hit_rect *area, int depth) {
+	if (container->type == C_VIEW) {
+		return;
+	}
+	if (container->layout == L_TABBED || container->layout == L_STACKED) {
+		swayc_t *focused = container->focused;
+		if (focused) {
+			hit_grid_add(grid, focused, area->x, area->y, area->width, area->height, depth + 1);
+			collect_containers(grid, focused, area, depth + 1);
 		}
+		return;
+	}
+	for (int i = 0; i < container->children->length; ++i) {
+		swayc_t *child = container->children->items[i];
+		if (!child->visible) {
+			continue;
+		}
+		struct hit_rect rect = {
+			.x = child->x, .y = child->y,
+			.width = child->width, .height = child->height,
+		};
+		hit_grid_add(grid, child, rect.x, rect.y, rect.width, rect.height, depth + 1);
+		collect_containers(grid, child, &rect, depth + 1);
+	}
+}
+
+static void collect_title_bar(struct hit_grid *grid, swayc_t *c) {
+	if (c->border_type == B_NORMAL) {
+		const struct wlc_geometry *title_bar = &c->title_bar_geometry;
+		hit_grid_add(grid, c, title_bar->origin.x, title_bar->origin.y,
+				title_bar->size.w, title_bar->size.h, 0);
 	}
-	return lookup;
+}
+
+static void collect_title_bars(struct hit_grid *grid, swayc_t *container) {
+	if (container->type == C_WORKSPACE) {
+		for (int i = 0; i < container->floating->length; ++i) {
+			collect_title_bar(grid, container->floating->items[i]);
+			collect_title_bars(grid, container->floating->items[i]);
+		}
+	}
+	if (!container->children) {
+		return;
+	}
+	for (int i = 0; i < container->children->length; ++i) {
+		collect_title_bar(grid, container->children->items[i]);
+		collect_title_bars(grid, container->children->items[i]);
+	}
+}
+
+static void free_hit_index(struct hit_index *index) {
+	if (!index) {
+		return;
+	}
+	hit_grid_reset(&index->containers);
+	hit_grid_reset(&index->title_bars);
+	free(index->containers.rects);
+	free(index->title_bars.rects);
+	free(index);
+}
+
+static struct hit_index *get_hit_index(swayc_t *workspace) {
+	if (!hit_indexes && !(hit_indexes = create_hash(hash_pointer, hash_pointer_cmp))) {
+		return NULL;
+	}
+	struct hit_index *index = hash_get(hit_indexes, workspace);
+	if (!index) {
+		if (!(index = calloc(1, sizeof(struct hit_index)))) {
+			return NULL;
+		}
+		hash_set(hit_indexes, workspace, index);
+	}
+	if (index->generation == hit_index_generation) {
+		return index;
+	}
+
+	struct hit_grid *grid = &index->containers;
+	hit_grid_reset(grid);
+	bool tabbed = workspace->layout == L_TABBED || workspace->layout == L_STACKED;
+	if (!tabbed) {
+		// topmost floating view first
+		for (int i = workspace->floating->length - 1; i >= 0; --i) {
+			swayc_t *view = workspace->floating->items[i];
+			if (view->visible) {
+				hit_grid_add(grid, view, view->x, view->y, view->width, view->height, 0);
+			}
+		}
+	}
+	int floating = grid->length;
+	// The workspace itself is never tested
+	struct hit_rect everything = { .width = -1, .height = 1 };
+	collect_containers(grid, workspace, &everything, 0);
+	qsort(grid->rects + floating, grid->length - floating,
+			sizeof(struct hit_rect), hit_rect_depth_cmp);
+	hit_grid_build(grid);
+
+	hit_grid_reset(&index->title_bars);
+	collect_title_bars(&index->title_bars, workspace);
+	hit_grid_build(&index->title_bars);
+
+	index->generation = hit_index_generation;
+	return index;
+}
+
+static void remove_hit_index(swayc_t *workspace) {
+	if (hit_indexes) {
+		free_hit_index(hash_del(hit_indexes, workspace));
+	}
+}
+
+swayc_t *container_under_pointer(void) {
+	// root.output->workspace
+	if (!root_container.focused || !root_container.focused->focused) {
+		return NULL;
+	}
+	swayc_t *workspace = root_container.focused->focused;
+	struct hit_index *index = get_hit_index(workspace);
+	if (!index) {
+		return NULL;
+	}
+	struct wlc_point origin;
+	wlc_pointer_get_position(&origin);
+	swayc_t *found = hit_grid_find(&index->containers, &origin);
+	return found ? found : workspace;
+}
+
+swayc_t *container_title_bar_at(swayc_t *workspace, const struct wlc_point *origin) {
+	struct hit_index *index = get_hit_index(workspace);
+	return index ? hit_grid_find(&index->title_bars, origin) : NULL;
 }
 
 swayc_t *container_find(swayc_t *container, bool (*f)(swayc_t *, const void *), const void *data) {
@@ -853,6 +1133,81 @@ void container_map(swayc_t *container, void (*f)(swayc_t *view, void *data), voi
 	}
 }
 
+// All marks, mapped to the container holding them. Keys are the strings in
+// that container's marks list.
+static hash_t *mark_index = NULL;
+
+swayc_t *container_by_mark(const char *mark) {
+	return mark_index ? hash_get(mark_index, mark) : NULL;
+}
+
+struct marks_foreach_data {
+	void (*f)(const char *mark, swayc_t *container, void *data);
+	void *data;
+};
+
+static void marks_foreach_callback(const void *key, void *value, void *data) {
+	struct marks_foreach_data *foreach = data;
+	foreach->f(key, value, foreach->data);
+}
+
+void container_marks_foreach(void (*f)(const char *mark, swayc_t *container, void *data), void *data) {
+	struct marks_foreach_data foreach = { f, data };
+	hash_foreach(mark_index, marks_foreach_callback, &foreach);
+}
+
+void container_add_mark(swayc_t *container, char *mark) {
+	if (!mark_index && !(mark_index = create_hash(hash_string, hash_string_cmp))) {
+		sway_log(L_ERROR, "Unable to allocate mark index");
+		free(mark);
+		return;
+	}
+	swayc_t *holder = hash_get(mark_index, mark);
+	if (holder == container) {
+		free(mark);
+		return;
+	} else if (holder) {
+		container_remove_mark(holder, mark);
+	}
+	if (!container->marks) {
+		container->marks = create_list();
+	}
+	list_add(container->marks, mark);
+	hash_set(mark_index, mark, container);
+}
+
+bool container_remove_mark(swayc_t *container, const char *mark) {
+	if (!container->marks) {
+		return false;
+	}
+	int index = list_seq_find(container->marks, (int (*)(const void *, const void *))strcmp, mark);
+	if (index == -1) {
+		return false;
+	}
+	char *item = container->marks->items[index];
+	hash_del(mark_index, item);
+	free(item);
+	list_del(container->marks, index);
+	if (container->marks->length == 0) {
+		list_free(container->marks);
+		container->marks = NULL;
+	}
+	return true;
+}
+
+void container_clear_marks(swayc_t *container) {
+	if (!container->marks) {
+		return;
+	}
+	for (int i = 0; i < container->marks->length; ++i) {
+		char *mark = container->marks->items[i];
+		hash_del(mark_index, mark);
+		free(mark);
+	}
+	list_free(container->marks);
+	container->marks = NULL;
+}
+
 void update_visibility_output(swayc_t *container, wlc_handle output) {
 	// Inherit visibility
 	swayc_t *parent = container->parent;
@@ -886,6 +1241,7 @@ void update_visibility_output(swayc_t *container, wlc_handle output) {
 
 void update_visibility(swayc_t *container) {
 	if (!container) return;
+	invalidate_container_index();
 	switch (container->type) {
 	case C_ROOT:
 		container->visible = true;
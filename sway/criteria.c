@@ -2,11 +2,15 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 #include <pcre.h>
 #include "sway/criteria.h"
 #include "sway/container.h"
+#include "sway/layout.h"
 #include "sway/config.h"
 #include "stringop.h"
+#include "intern.h"
+#include "hash.h"
 #include "list.h"
 #include "log.h"
 
@@ -42,16 +46,26 @@ static const char * const criteria_strings[CRIT_LAST] = {
 struct crit_token {
 	enum criteria_type type;
 	pcre *regex;
+	pcre_extra *regex_extra;
+	// Set instead of regex for values without regex syntax. exact is the
+	// interned string of a value of the form ^literal$, so that it can be
+	// compared by address with interned view attributes.
+	char *exact;
+	bool substring;
 	char *raw;
 };
 
 static void free_crit_token(struct crit_token *crit) {
+	if (crit->regex_extra) {
+		pcre_free_study(crit->regex_extra);
+	}
 	pcre_free(crit->regex);
+	release_interned_string(crit->exact);
 	free(crit->raw);
 	free(crit);
 }
 
-static void free_crit_tokens(list_t *crit_tokens) {
+void free_crit_tokens(list_t *crit_tokens) {
 	for (int i = 0; i < crit_tokens->length; i++) {
 		free_crit_token(crit_tokens->items[i]);
 	}
@@ -184,7 +198,7 @@ static char *parse_criteria_name(enum criteria_type *type, char *name) {
 }
 
 // Returns error string on failure or NULL otherwise.
-static char *generate_regex(pcre **regex, char *value) {
+static char *generate_regex(pcre **regex, pcre_extra **extra, char *value) {
 	const char *reg_err;
 	int offset;
 
@@ -197,9 +211,77 @@ static char *generate_regex(pcre **regex, char *value) {
 		snprintf(error, len, fmt, value, reg_err);
 		return error;
 	}
+
+	// Criteria are matched far more often than they are compiled
+#ifdef PCRE_STUDY_JIT_COMPILE
+	*extra = pcre_study(*regex, PCRE_STUDY_JIT_COMPILE, &reg_err);
+#else
+	*extra = pcre_study(*regex, 0, &reg_err);
+#endif
+	if (!*extra && reg_err) {
+		sway_log(L_DEBUG, "Unable to study regex '%s': %s", value, reg_err);
+	}
 	return NULL;
 }
 
+// Returns true if value matches itself literally when used as a regex
+static bool is_literal(const char *value, size_t len) {
+	for (size_t i = 0; i < len; ++i) {
+		if (strchr("\\^$.|?*+()[]{}", value[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Matches values without any regex syntax without going through pcre. An
+// anchored literal becomes an exact match, an unanchored one a substring
+// match. Returns false if value needs a real regex.
+static bool generate_literal(struct crit_token *token, const char *value) {
+	size_t len = strlen(value);
+	if (len >= 2 && value[0] == '^' && value[len - 1] == '$'
+			&& is_literal(value + 1, len - 2)) {
+		char *literal = malloc(len - 1);
+		if (!literal) {
+			return false;
+		}
+		memcpy(literal, value + 1, len - 2);
+		literal[len - 2] = '\0';
+		token->exact = intern_string(literal);
+		free(literal);
+		return token->exact != NULL;
+	}
+	if (is_literal(value, len)) {
+		token->substring = true;
+		return true;
+	}
+	return false;
+}
+
+// Cheaper tokens go first, so a view is rejected before any regex runs
+static int crit_token_cost(const struct crit_token *token) {
+	int cost;
+	if (token->exact) {
+		cost = 0;
+	} else if (token->substring) {
+		cost = 1;
+	} else if (!token->regex) {
+		cost = 2;
+	} else {
+		cost = 3;
+	}
+	if (token->type == CRIT_CON_MARK || token->type == CRIT_WORKSPACE) {
+		// needs to look at every mark or walk up the tree
+		cost += 4;
+	}
+	return cost;
+}
+
+static int crit_token_cost_cmp(const void *a, const void *b) {
+	return crit_token_cost(*(struct crit_token **)a)
+		- crit_token_cost(*(struct crit_token **)b);
+}
+
 // Test whether the criterion corresponds to the currently focused window
 static bool crit_is_focused(const char *value) {
 	return !strcmp(value, "focused") || !strcmp(value, "__focused__");
@@ -224,7 +306,10 @@ char *extract_crit_tokens(list_t *tokens, const char * const criteria) {
 		} else if (token->type == CRIT_URGENT || crit_is_focused(value)) {
 			sway_log(L_DEBUG, "%s -> \"%s\"", name, value);
 			list_add(tokens, token);
-		} else if((error = generate_regex(&token->regex, value))) {
+		} else if (token->type != CRIT_CON_MARK && generate_literal(token, value)) {
+			sway_log(L_DEBUG, "%s -> '%s'", name, value);
+			list_add(tokens, token);
+		} else if((error = generate_regex(&token->regex, &token->regex_extra, value))) {
 			free_crit_token(token);
 			goto ect_cleanup;
 		} else {
@@ -232,6 +317,7 @@ char *extract_crit_tokens(list_t *tokens, const char * const criteria) {
 			list_add(tokens, token);
 		}
 	}
+	list_stable_sort(tokens, crit_token_cost_cmp);
 ect_cleanup:
 	free(argv[0]); // base string
 	free(argv);
@@ -242,92 +328,93 @@ static int regex_cmp(const char *item, const pcre *regex) {
 	return pcre_exec(regex, NULL, item, strlen(item), 0, 0, NULL, 0);
 }
 
+// Tests a view attribute against a token that isn't a "focused" token.
+// interned is true if value is an interned string.
+static bool crit_value_test(struct crit_token *crit, const char *value, bool interned) {
+	if (crit->exact) {
+		return interned ? value == crit->exact : strcmp(value, crit->exact) == 0;
+	} else if (crit->substring) {
+		return strstr(value, crit->raw) != NULL;
+	} else if (crit->regex) {
+		return pcre_exec(crit->regex, crit->regex_extra,
+				value, strlen(value), 0, 0, NULL, 0) == 0;
+	}
+	return false;
+}
+
+// test a view against a single criteria token
+static bool crit_token_test(swayc_t *cont, struct crit_token *crit) {
+	switch (crit->type) {
+	case CRIT_CLASS:
+		if (!cont->class) {
+			return false;
+		} else if (crit_is_focused(crit->raw)) {
+			swayc_t *focused = get_focused_view(&root_container);
+			return focused->class && cont->class == focused->class;
+		}
+		return crit_value_test(crit, cont->class, true);
+	case CRIT_CON_MARK:
+		if (crit->regex && cont->marks && (list_seq_find(cont->marks, (int (*)(const void *, const void *))regex_cmp, crit->regex) != -1)) {
+			// Make sure it isn't matching the NUL string
+			return (strcmp(crit->raw, "") == 0) == (list_seq_find(cont->marks, (int (*)(const void *, const void *))strcmp, "") != -1);
+		}
+		return false;
+	case CRIT_ID:
+		if (!cont->app_id) {
+			return false;
+		}
+		return crit_value_test(crit, cont->app_id, true);
+	case CRIT_INSTANCE:
+		if (!cont->instance) {
+			return false;
+		} else if (crit_is_focused(crit->raw)) {
+			swayc_t *focused = get_focused_view(&root_container);
+			return focused->instance && cont->instance == focused->instance;
+		}
+		return crit_value_test(crit, cont->instance, true);
+	case CRIT_TITLE:
+		if (!cont->name) {
+			return false;
+		} else if (crit_is_focused(crit->raw)) {
+			swayc_t *focused = get_focused_view(&root_container);
+			return focused->name && strcmp(cont->name, focused->name) == 0;
+		}
+		return crit_value_test(crit, cont->name, false);
+	case CRIT_URGENT: // "latest" or "oldest"
+		return false;
+	case CRIT_WINDOW_ROLE:
+		return false;
+	case CRIT_WINDOW_TYPE:
+		// TODO wlc indeed exposes this information
+		return false;
+	case CRIT_WORKSPACE: ;
+		swayc_t *cont_ws = swayc_parent_by_type(cont, C_WORKSPACE);
+		if (!cont_ws || !cont_ws->name) {
+			return false;
+		} else if (crit_is_focused(crit->raw)) {
+			swayc_t *focused_ws = swayc_active_workspace();
+			return focused_ws->name && strcmp(cont_ws->name, focused_ws->name) == 0;
+		}
+		return crit_value_test(crit, cont_ws->name, false);
+	default:
+		sway_abort("Invalid criteria type (%i)", crit->type);
+		break;
+	}
+	return false;
+}
+
 // test a single view if it matches list of criteria tokens (all of them).
 static bool criteria_test(swayc_t *cont, list_t *tokens) {
 	if (cont->type != C_VIEW) {
 		return false;
 	}
-	int matches = 0;
+	// tokens are sorted cheapest first, see crit_token_cost
 	for (int i = 0; i < tokens->length; i++) {
-		struct crit_token *crit = tokens->items[i];
-		switch (crit->type) {
-		case CRIT_CLASS:
-			if (!cont->class) {
-				// ignore
-			} else if (crit_is_focused(crit->raw)) {
-				swayc_t *focused = get_focused_view(&root_container);
-				if (focused->class && strcmp(cont->class, focused->class) == 0) {
-					matches++;
-				}
-			} else if (crit->regex && regex_cmp(cont->class, crit->regex) == 0) {
-				matches++;
-			}
-			break;
-		case CRIT_CON_MARK:
-			if (crit->regex && cont->marks && (list_seq_find(cont->marks, (int (*)(const void *, const void *))regex_cmp, crit->regex) != -1)) {
-				// Make sure it isn't matching the NUL string
-				if ((strcmp(crit->raw, "") == 0) == (list_seq_find(cont->marks, (int (*)(const void *, const void *))strcmp, "") != -1)) {
-					++matches;
-				}
-			}
-			break;
-		case CRIT_ID:
-			if (!cont->app_id) {
-				// ignore
-			} else if (crit->regex && regex_cmp(cont->app_id, crit->regex) == 0) {
-				matches++;
-			}
-			break;
-		case CRIT_INSTANCE:
-			if (!cont->instance) {
-				// ignore
-			} else if (crit_is_focused(crit->raw)) {
-				swayc_t *focused = get_focused_view(&root_container);
-				if (focused->instance && strcmp(cont->instance, focused->instance) == 0) {
-					matches++;
-				}
-			} else if (crit->regex && regex_cmp(cont->instance, crit->regex) == 0) {
-				matches++;
-			}
-			break;
-		case CRIT_TITLE:
-			if (!cont->name) {
-				// ignore
-			} else if (crit_is_focused(crit->raw)) {
-				swayc_t *focused = get_focused_view(&root_container);
-				if (focused->name && strcmp(cont->name, focused->name) == 0) {
-					matches++;
-				}
-			} else if (crit->regex && regex_cmp(cont->name, crit->regex) == 0) {
-				matches++;
-			}
-			break;
-		case CRIT_URGENT: // "latest" or "oldest"
-			break;
-		case CRIT_WINDOW_ROLE:
-			break;
-		case CRIT_WINDOW_TYPE:
-			// TODO wlc indeed exposes this information
-			break;
-		case CRIT_WORKSPACE: ;
-			swayc_t *cont_ws = swayc_parent_by_type(cont, C_WORKSPACE);
-			if (!cont_ws || !cont_ws->name) {
-				// ignore
-			} else if (crit_is_focused(crit->raw)) {
-				swayc_t *focused_ws = swayc_active_workspace();
-				if (focused_ws->name && strcmp(cont_ws->name, focused_ws->name) == 0) {
-					matches++;
-				}
-			} else if (crit->regex && regex_cmp(cont_ws->name, crit->regex) == 0) {
-				matches++;
-			}
-			break;
-		default:
-			sway_abort("Invalid criteria type (%i)", crit->type);
-			break;
+		if (!crit_token_test(cont, tokens->items[i])) {
+			return false;
 		}
 	}
-	return matches == tokens->length;
+	return true;
 }
 
 int criteria_cmp(const void *a, const void *b) {
@@ -380,6 +467,55 @@ list_t *criteria_for(swayc_t *cont) {
 	return matches;
 }
 
+// Views by their interned class, instance and app_id
+static hash_t *views_by_class = NULL;
+static hash_t *views_by_instance = NULL;
+static hash_t *views_by_app_id = NULL;
+
+static void add_to_view_index(hash_t **index, char *key, swayc_t *view) {
+	if (!key) {
+		return;
+	}
+	if (!*index && !(*index = create_hash(hash_pointer, hash_pointer_cmp))) {
+		return;
+	}
+	list_t *views = hash_get(*index, key);
+	if (!views) {
+		views = create_list();
+		hash_set(*index, key, views);
+	}
+	list_add(views, view);
+}
+
+static void remove_from_view_index(hash_t *index, char *key, swayc_t *view) {
+	list_t *views;
+	if (!key || !index || !(views = hash_get(index, key))) {
+		return;
+	}
+	for (int i = 0; i < views->length; ++i) {
+		if (views->items[i] == view) {
+			list_del(views, i);
+			break;
+		}
+	}
+	if (views->length == 0) {
+		hash_del(index, key);
+		list_free(views);
+	}
+}
+
+void index_view(swayc_t *view) {
+	add_to_view_index(&views_by_class, view->class, view);
+	add_to_view_index(&views_by_instance, view->instance, view);
+	add_to_view_index(&views_by_app_id, view->app_id, view);
+}
+
+void unindex_view(swayc_t *view) {
+	remove_from_view_index(views_by_class, view->class, view);
+	remove_from_view_index(views_by_instance, view->instance, view);
+	remove_from_view_index(views_by_app_id, view->app_id, view);
+}
+
 struct list_tokens {
 	list_t *list;
 	list_t *tokens;
@@ -390,10 +526,161 @@ static void container_match_add(swayc_t *container, struct list_tokens *list_tok
 		list_add(list_tokens->list, container);
 	}
 }
+
+// Views in the scratchpad aren't part of the tree and can't be matched
+static bool in_tree(swayc_t *view) {
+	while (view->parent) {
+		view = view->parent;
+	}
+	return view == &root_container;
+}
+
+// Finds the smallest set of views a list of tokens can match, without
+// testing any of them. Returns false if every view has to be tested.
+static bool indexed_candidates(list_t *tokens, list_t **views, swayc_t **workspace) {
+	swayc_t *ws = NULL;
+	for (int i = 0; i < tokens->length; ++i) {
+		struct crit_token *crit = tokens->items[i];
+		if (!crit->exact) {
+			continue;
+		}
+		hash_t *index = NULL;
+		switch (crit->type) {
+		case CRIT_CLASS:
+			index = views_by_class;
+			break;
+		case CRIT_INSTANCE:
+			index = views_by_instance;
+			break;
+		case CRIT_ID:
+			index = views_by_app_id;
+			break;
+		case CRIT_WORKSPACE:
+			for (int o = 0; !ws && o < root_container.children->length; ++o) {
+				swayc_t *output = root_container.children->items[o];
+				for (int w = 0; w < output->children->length; ++w) {
+					swayc_t *find = output->children->items[w];
+					if (find->name && strcmp(find->name, crit->exact) == 0) {
+						ws = find;
+						break;
+					}
+				}
+			}
+			if (!ws) {
+				// no such workspace, nothing can match
+				*views = NULL;
+				*workspace = NULL;
+				return true;
+			}
+			continue;
+		default:
+			continue;
+		}
+		*views = index ? hash_get(index, crit->exact) : NULL;
+		*workspace = NULL;
+		return true;
+	}
+	if (ws) {
+		*views = NULL;
+		*workspace = ws;
+		return true;
+	}
+	return false;
+}
+
+// Position among the siblings in container_map order, floating containers
+// come after the tiled ones.
+static int sibling_position(swayc_t *container) {
+	int index = index_child(container);
+	if (container->is_floating) {
+		index += container->parent->children->length;
+	}
+	return index;
+}
+
+static int container_depth(swayc_t *container) {
+	int depth = 0;
+	while ((container = container->parent)) {
+		++depth;
+	}
+	return depth;
+}
+
+// Orders containers the way a walk of the tree visits them, parents first.
+static int tree_order_qsort(const void *_a, const void *_b) {
+	swayc_t *a = *(swayc_t **)_a, *b = *(swayc_t **)_b;
+	int depth_a = container_depth(a), depth_b = container_depth(b);
+	int ancestor = 0;
+	for (; depth_a > depth_b; --depth_a) {
+		a = a->parent;
+		ancestor = 1;
+	}
+	for (; depth_b > depth_a; --depth_b) {
+		b = b->parent;
+		ancestor = -1;
+	}
+	if (a == b) {
+		return ancestor;
+	}
+	while (a->parent != b->parent) {
+		a = a->parent;
+		b = b->parent;
+	}
+	return sibling_position(a) - sibling_position(b);
+}
+
+struct mark_tokens {
+	struct crit_token *crit;
+	struct list_tokens *list_tokens;
+};
+
+static void container_mark_match_add(const char *mark, swayc_t *container, void *data) {
+	struct mark_tokens *mark_tokens = data;
+	list_t *list = mark_tokens->list_tokens->list;
+	if (regex_cmp(mark, mark_tokens->crit->regex) == 0 && in_tree(container)
+			&& list_seq_find(list, hash_pointer_cmp, container) == -1) {
+		container_match_add(container, mark_tokens->list_tokens);
+	}
+}
+
+static struct crit_token *find_con_mark_token(list_t *tokens) {
+	for (int i = 0; i < tokens->length; ++i) {
+		struct crit_token *crit = tokens->items[i];
+		if (crit->type == CRIT_CON_MARK && crit->regex) {
+			return crit;
+		}
+	}
+	return NULL;
+}
+
 list_t *container_for(list_t *tokens) {
 	struct list_tokens list_tokens = (struct list_tokens){create_list(), tokens};
 
-	container_map(&root_container, (void (*)(swayc_t *, void *))container_match_add, &list_tokens);
+	list_t *views = NULL;
+	swayc_t *workspace = NULL;
+	struct crit_token *con_mark = NULL;
+	if (!indexed_candidates(tokens, &views, &workspace)) {
+		if ((con_mark = find_con_mark_token(tokens))) {
+			// only marked containers can match, look at the marks instead of the tree
+			struct mark_tokens mark_tokens = { con_mark, &list_tokens };
+			container_marks_foreach(container_mark_match_add, &mark_tokens);
+			// marks are visited in hash order
+			list_qsort(list_tokens.list, tree_order_qsort);
+		} else {
+			container_map(&root_container, (void (*)(swayc_t *, void *))container_match_add, &list_tokens);
+		}
+	} else if (workspace) {
+		container_map(workspace, (void (*)(swayc_t *, void *))container_match_add, &list_tokens);
+	} else if (views) {
+		for (int i = 0; i < views->length; ++i) {
+			swayc_t *view = views->items[i];
+			if (in_tree(view)) {
+				container_match_add(view, &list_tokens);
+			}
+		}
+		// the index keeps views in creation order
+		list_qsort(list_tokens.list, tree_order_qsort);
+	}
 
 	return list_tokens.list;
 }
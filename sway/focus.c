@@ -23,6 +23,7 @@ static void update_focus(swayc_t *c) {
 		swayc_t *prev = parent->focused;
 		// Set new focus
 		parent->focused = c;
+		invalidate_container_index();
 
 		switch (c->type) {
 		// Shouldn't happen
@@ -48,6 +49,9 @@ static void update_focus(swayc_t *c) {
 			}
 			// Update visibility of newly focused workspace
 			update_visibility(c);
+			if (c->layout_stale) {
+				arrange_windows(c, -1, -1);
+			}
 			break;
 
 		default:
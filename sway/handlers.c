@@ -9,6 +9,7 @@
 #include <wlc/wlc-render.h>
 #include <wlc/wlc-wayland.h>
 #include <ctype.h>
+#include <time.h>
 #include "sway/handlers.h"
 #include "sway/border.h"
 #include "sway/layout.h"
@@ -34,6 +35,18 @@
 // Event handled by sway and should not be sent to client
 #define EVENT_HANDLED true
 
+// Title changes are applied at most once per frame, and at most
+// config->title_update_rate times per second for each view
+struct title_update {
+	char *title; // latest title not applied yet, or NULL
+	uint32_t applied; // time of the last applied change in ms
+	unsigned int dropped; // changes replaced before they were applied
+};
+
+// Views with title updates, keyed by container
+static hash_t *title_updates = NULL;
+static struct wlc_event_source *title_update_timer = NULL;
+
 static struct panel_config *if_panel_find_config(struct wl_client *client) {
 	int i;
 	for (i = 0; i < desktop_shell.panels->length; i++) {
@@ -209,6 +222,92 @@ static void handle_output_destroyed(wlc_handle output) {
 	}
 }
 
+static uint32_t get_time_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void apply_title_update(swayc_t *c, char *title) {
+	if (c->name && strcmp(c->name, title) == 0) {
+		free(title);
+		return;
+	}
+	free(c->name);
+	c->name = title;
+	swayc_t *p = swayc_tabbed_stacked_ancestor(c);
+	if (p) {
+		// TODO: we only got the topmost tabbed/stacked container, update borders of all containers on the path
+		update_container_border(get_focused_view(p));
+	} else if (c->border_type == B_NORMAL) {
+		update_container_border(c);
+	}
+	ipc_event_window(c, "title");
+}
+
+struct title_flush {
+	uint32_t now;
+	int next; // ms until the next held back update is due, or -1
+};
+
+static void flush_title_update(const void *key, void *value, void *data) {
+	struct title_update *update = value;
+	struct title_flush *flush = data;
+	if (!update->title) {
+		return;
+	}
+	if (config->title_update_rate > 0) {
+		uint32_t interval = 1000 / config->title_update_rate;
+		uint32_t elapsed = flush->now - update->applied;
+		if (elapsed < interval) {
+			int wait = interval - elapsed;
+			if (flush->next < 0 || wait < flush->next) {
+				flush->next = wait;
+			}
+			return;
+		}
+	}
+	char *title = update->title;
+	update->title = NULL;
+	update->applied = flush->now;
+	apply_title_update((swayc_t *)key, title);
+}
+
+static int flush_title_updates(void *data) {
+	if (!title_updates) {
+		return 0;
+	}
+	struct title_flush flush = { get_time_ms(), -1 };
+	hash_foreach(title_updates, flush_title_update, &flush);
+	if (flush.next >= 0) {
+		if (!title_update_timer) {
+			title_update_timer = wlc_event_loop_add_timer(flush_title_updates, NULL);
+		}
+		if (title_update_timer) {
+			// a zero delay would disarm the timer
+			wlc_event_source_timer_update(title_update_timer, flush.next + 1);
+		}
+	}
+	return 0;
+}
+
+static void remove_title_update(swayc_t *view) {
+	struct title_update *update = title_updates ? hash_del(title_updates, view) : NULL;
+	if (!update) {
+		return;
+	}
+	if (update->dropped) {
+		sway_log(L_DEBUG, "Dropped %u title updates of view %p", update->dropped, view);
+	}
+	free(update->title);
+	free(update);
+}
+
+static void handle_output_pre_render(wlc_handle output) {
+	pointer_mode_flush();
+	flush_title_updates(NULL);
+}
+
 static void handle_output_post_render(wlc_handle output) {
 	ipc_get_pixels(output);
 }
@@ -230,7 +329,8 @@ static void handle_output_resolution_change(wlc_handle output, const struct wlc_
 	update_panel_geometries(output);
 	update_background_geometries(output);
 
-	arrange_windows(&root_container, -1, -1);
+	invalidate_output_neighbors();
+	schedule_output_settle(OUTPUT_RESIZED);
 }
 
 static void handle_output_focused(wlc_handle output, bool focus) {
@@ -541,6 +641,7 @@ static void handle_view_destroyed(wlc_handle handle) {
 	if (view) {
 		bool fullscreen = swayc_is_fullscreen(view);
 		remove_view_from_scratchpad(view);
+		remove_title_update(view);
 		swayc_t *parent = destroy_view(view);
 		if (fullscreen) {
 			parent->fullscreen = NULL;
@@ -605,9 +706,11 @@ static void handle_view_geometry_request(wlc_handle handle, const struct wlc_geo
 static void handle_view_state_request(wlc_handle view, enum wlc_view_state_bit state, bool toggle) {
 	swayc_t *c = swayc_by_handle(view);
 	pid_t pid = wlc_view_get_pid(view);
+	uint32_t features;
 	switch (state) {
 	case WLC_BIT_FULLSCREEN:
-		if (!(get_feature_policy_mask(pid) & FEATURE_FULLSCREEN)) {
+		features = c ? get_view_feature_policy_mask(c) : get_feature_policy_mask(pid);
+		if (!(features & FEATURE_FULLSCREEN)) {
 			sway_log(L_INFO, "Denying fullscreen to %d (%s)", pid, c->name);
 			break;
 		}
@@ -645,47 +748,66 @@ static void handle_view_properties_updated(wlc_handle view, uint32_t mask) {
 			return;
 		}
 
-		// update window title
+		// update window title on the next frame
 		const char *new_name = wlc_view_get_title(view);
-
-		if (new_name) {
-			if (!c->name || strcmp(c->name, new_name) != 0) {
-				free(c->name);
-				c->name = strdup(new_name);
-				swayc_t *p = swayc_tabbed_stacked_ancestor(c);
-				if (p) {
-					// TODO: we only got the topmost tabbed/stacked container, update borders of all containers on the path
-					update_container_border(get_focused_view(p));
-				} else if (c->border_type == B_NORMAL) {
-					update_container_border(c);
-				}
-				ipc_event_window(c, "title");
+		if (!new_name) {
+			return;
+		}
+		if (!title_updates && !(title_updates = create_hash(hash_pointer, hash_pointer_cmp))) {
+			apply_title_update(c, strdup(new_name));
+			return;
+		}
+		struct title_update *update = hash_get(title_updates, c);
+		if (!update) {
+			if (c->name && strcmp(c->name, new_name) == 0) {
+				return;
 			}
+			if (!(update = calloc(1, sizeof(struct title_update)))) {
+				apply_title_update(c, strdup(new_name));
+				return;
+			}
+			hash_set(title_updates, c, update);
+		}
+		if (update->title) {
+			++update->dropped;
+			free(update->title);
 		}
+		update->title = strdup(new_name);
+		wlc_output_schedule_render(wlc_view_get_output(view));
 	}
 }
 
 static void handle_binding_command(struct sway_binding *binding) {
 	struct sway_binding *binding_copy = binding;
-	bool reload = false;
-	// if this is a reload command we need to make a duplicate of the
-	// binding since it will be gone after the reload has completed.
-	if (strcasecmp(binding->command, "reload") == 0) {
+	struct compiled_commands *compiled = binding->compiled;
+	bool reload = compiled ? compiled_commands_call(compiled, cmd_reload)
+		: strcasecmp(binding->command, "reload") == 0;
+	// reload and bindsym/bindcode may free the binding while its commands
+	// run, so the ipc event needs a duplicate that outlives them.
+	bool copy = reload || (compiled
+		&& (compiled_commands_call(compiled, cmd_bindsym)
+			|| compiled_commands_call(compiled, cmd_bindcode)));
+	if (copy) {
 		binding_copy = sway_binding_dup(binding);
 		if (!binding_copy) {
-			sway_log(L_ERROR, "Unable to duplicate binding during reload");
+			sway_log(L_ERROR, "Unable to duplicate binding");
 			return;
 		}
-		reload = true;
 	}
 
-	struct cmd_results *res = handle_command(binding->command, CONTEXT_BINDING);
+	struct cmd_results *res;
+	if (!reload && compiled) {
+		// run_compiled_commands holds a reference until it is done
+		res = run_compiled_commands(compiled);
+	} else {
+		res = handle_command(binding_copy->command, CONTEXT_BINDING);
+	}
 	if (res->status != CMD_SUCCESS) {
 		sway_log(L_ERROR, "Command '%s' failed: %s", res->input, res->error);
 	}
 	ipc_event_binding_keyboard(binding_copy);
 
-	if (reload) { // free the binding if we made a copy
+	if (copy) { // free the binding if we made a copy
 		free_sway_binding(binding_copy);
 	}
 
@@ -713,38 +835,6 @@ static bool handle_bindsym(struct sway_binding *binding, uint32_t keysym, uint32
 	return false;
 }
 
-static bool valid_bindsym(struct sway_binding *binding) {
-	bool match = false;
-	int i;
-	for (i = 0; i < binding->keys->length; ++i) {
-		if (binding->bindcode) {
-			xkb_keycode_t *key = binding->keys->items[i];
-			if ((match = check_key(0, *key)) == false) {
-				break;
-			}
-		} else {
-			xkb_keysym_t *key = binding->keys->items[i];
-			if ((match = check_key(*key, 0)) == false) {
-				break;
-			}
-		}
-	}
-
-	return match;
-}
-
-static bool handle_bindsym_release(struct sway_binding *binding) {
-	if (binding->keys->length == 1) {
-		xkb_keysym_t *key = binding->keys->items[0];
-		if (check_released_key(*key)) {
-			handle_binding_command(binding);
-			return true;
-		}
-	}
-
-	return false;
-}
-
 static bool handle_key(wlc_handle view, uint32_t time, const struct wlc_modifiers *modifiers,
 		uint32_t key, enum wlc_key_state state) {
 
@@ -788,42 +878,20 @@ static bool handle_key(wlc_handle view, uint32_t time, const struct wlc_modifier
 	modifiers_state_update(modifiers->mods);
 
 	// handle bindings
-	list_t *candidates = create_list();
-	for (i = 0; i < mode->bindings->length; ++i) {
-		struct sway_binding *binding = mode->bindings->items[i];
-		if ((modifiers->mods ^ binding->modifiers) == 0) {
-			switch (state) {
-			case WLC_KEY_STATE_PRESSED: {
-				if (!binding->release && valid_bindsym(binding)) {
-					list_add(candidates, binding);
-				}
-			}
-			case WLC_KEY_STATE_RELEASED:
-				if (binding->release && handle_bindsym_release(binding)) {
-					list_free(candidates);
-					return EVENT_HANDLED;
-				}
-				break;
-			}
-		}
+	struct sway_binding *binding;
+	if (state == WLC_KEY_STATE_PRESSED) {
+		binding = find_press_binding(mode, modifiers->mods, sym, key);
+	} else { // WLC_KEY_STATE_RELEASED
+		binding = find_release_binding(mode, modifiers->mods);
 	}
-
-	for (i = 0; i < candidates->length; ++i) {
-		struct sway_binding *binding = candidates->items[i];
-		if (state == WLC_KEY_STATE_PRESSED) {
-			if (!binding->release && handle_bindsym(binding, sym, key)) {
-				list_free(candidates);
-				return EVENT_HANDLED;
-			}
-		}
+	if (binding) {
+		handle_binding_command(binding);
+		return EVENT_HANDLED;
 	}
 
-	list_free(candidates);
-
 	swayc_t *focused = get_focused_container(&root_container);
 	if (focused->type == C_VIEW) {
-		pid_t pid = wlc_view_get_pid(focused->handle);
-		if (!(get_feature_policy_mask(pid) & FEATURE_KEYBOARD)) {
+		if (!(get_view_feature_policy_mask(focused) & FEATURE_KEYBOARD)) {
 			return EVENT_HANDLED;
 		}
 	}
@@ -886,8 +954,7 @@ static bool handle_pointer_motion(wlc_handle handle, uint32_t time, const struct
 
 	swayc_t *focused = get_focused_container(&root_container);
 	if (focused->type == C_VIEW) {
-		pid_t pid = wlc_view_get_pid(focused->handle);
-		if (!(get_feature_policy_mask(pid) & FEATURE_MOUSE)) {
+		if (!(get_view_feature_policy_mask(focused) & FEATURE_MOUSE)) {
 			return EVENT_HANDLED;
 		}
 	}
@@ -895,22 +962,6 @@ static bool handle_pointer_motion(wlc_handle handle, uint32_t time, const struct
 	return EVENT_PASSTHROUGH;
 }
 
-static bool swayc_border_check(swayc_t *c, const void *_origin) {
-	const struct wlc_point *origin = _origin;
-	const struct wlc_geometry title_bar = c->title_bar_geometry;
-
-	if (c->border_type != B_NORMAL) {
-		return false;
-	}
-
-	if (origin->x >= title_bar.origin.x && origin->y >= title_bar.origin.y
-		&& origin->x < title_bar.origin.x + (int32_t)title_bar.size.w
-		&& origin->y < title_bar.origin.y + (int32_t)title_bar.size.h) {
-		return true;
-	}
-	return false;
-}
-
 static bool handle_pointer_button(wlc_handle view, uint32_t time, const struct wlc_modifiers *modifiers,
 		uint32_t button, enum wlc_button_state state, const struct wlc_point *origin) {
 
@@ -984,8 +1035,7 @@ static bool handle_pointer_button(wlc_handle view, uint32_t time, const struct w
 	// don't change focus or mode if fullscreen
 	if (swayc_is_fullscreen(focused)) {
 		if (focused->type == C_VIEW) {
-			pid_t pid = wlc_view_get_pid(focused->handle);
-			if (!(get_feature_policy_mask(pid) & FEATURE_MOUSE)) {
+			if (!(get_view_feature_policy_mask(focused) & FEATURE_MOUSE)) {
 				return EVENT_HANDLED;
 			}
 		}
@@ -1002,7 +1052,7 @@ static bool handle_pointer_button(wlc_handle view, uint32_t time, const struct w
 	if (pointer) {
 		swayc_t *ws = swayc_parent_by_type(focused, C_WORKSPACE);
 		if (ws != NULL) {
-				swayc_t *find = container_find(ws, &swayc_border_check, origin);
+				swayc_t *find = container_title_bar_at(ws, origin);
 				if (find != NULL) {
 					set_focused_container(find);
 					return EVENT_HANDLED;
@@ -1019,6 +1069,7 @@ static bool handle_pointer_button(wlc_handle view, uint32_t time, const struct w
 				if (pointer->parent->floating->items[i] == pointer) {
 					list_del(pointer->parent->floating, i);
 					list_add(pointer->parent->floating, pointer);
+					invalidate_container_index();
 					break;
 				}
 			}
@@ -1032,8 +1083,7 @@ static bool handle_pointer_button(wlc_handle view, uint32_t time, const struct w
 	}
 
 	if (focused->type == C_VIEW) {
-		pid_t pid = wlc_view_get_pid(focused->handle);
-		if (!(get_feature_policy_mask(pid) & FEATURE_MOUSE)) {
+		if (!(get_view_feature_policy_mask(focused) & FEATURE_MOUSE)) {
 			return EVENT_HANDLED;
 		}
 	}
@@ -1076,16 +1126,17 @@ static void handle_wlc_ready(void) {
 	sway_log(L_DEBUG, "Compositor is ready, executing cmds in queue");
 	// Execute commands until there are none left
 	config->active = true;
-	while (config->cmd_queue->length) {
-		char *line = config->cmd_queue->items[0];
-		struct cmd_results *res = handle_command(line, CONTEXT_CONFIG);
+	for (int i = 0; i < config->cmd_queue->length; ++i) {
+		struct compiled_commands *commands = config->cmd_queue->items[i];
+		struct cmd_results *res = run_compiled_commands(commands);
 		if (res->status != CMD_SUCCESS) {
-			sway_log(L_ERROR, "Error on line '%s': %s", line, res->error);
+			sway_log(L_ERROR, "Error on deferred command '%s': %s",
+					res->input ? res->input : "", res->error);
 		}
 		free_cmd_results(res);
-		free(line);
-		list_del(config->cmd_queue, 0);
+		free_compiled_commands(commands);
 	}
+	config->cmd_queue->length = 0;
 }
 
 void register_wlc_handlers() {
@@ -1093,6 +1144,7 @@ void register_wlc_handlers() {
 	wlc_set_output_destroyed_cb(handle_output_destroyed);
 	wlc_set_output_resolution_cb(handle_output_resolution_change);
 	wlc_set_output_focus_cb(handle_output_focused);
+	wlc_set_output_render_pre_cb(handle_output_pre_render);
 	wlc_set_output_render_post_cb(handle_output_post_render);
 	wlc_set_view_created_cb(handle_view_created);
 	wlc_set_view_destroyed_cb(handle_view_destroyed);
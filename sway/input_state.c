@@ -5,116 +5,6 @@
 #include "sway/config.h"
 #include "log.h"
 
-#define KEY_STATE_MAX_LENGTH 64
-
-struct key_state {
-	/*
-	 * Aims to store state regardless of modifiers.
-	 * If you press a key, then hold shift, then release the key, we'll
-	 * get two different key syms, but the same key code. This handles
-	 * that scenario and makes sure we can use the right bindings.
-	 */
-	uint32_t key_sym;
-	uint32_t alt_sym;
-	uint32_t key_code;
-};
-
-static struct key_state key_state_array[KEY_STATE_MAX_LENGTH];
-
-static struct key_state last_released;
-
-static uint32_t modifiers_state;
-
-void input_init(void) {
-	int i;
-	for (i = 0; i < KEY_STATE_MAX_LENGTH; ++i) {
-		struct key_state none = { 0, 0, 0 };
-		key_state_array[i] = none;
-	}
-
-	struct key_state none = { 0, 0, 0 };
-	last_released = none;
-
-	modifiers_state = 0;
-}
-
-uint32_t modifier_state_changed(uint32_t new_state, uint32_t mod) {
-	if ((new_state & mod) != 0) { // pressed
-		if ((modifiers_state & mod) != 0) { // already pressed
-			return MOD_STATE_UNCHANGED;
-		} else { // pressed
-			return MOD_STATE_PRESSED;
-		}
-	} else { // not pressed
-		if ((modifiers_state & mod) != 0) { // released
-			return MOD_STATE_RELEASED;
-		} else { // already released
-			return MOD_STATE_UNCHANGED;
-		}
-	}
-}
-
-void modifiers_state_update(uint32_t new_state) {
-	modifiers_state = new_state;
-}
-
-static uint8_t find_key(uint32_t key_sym, uint32_t key_code, bool update) {
-	int i;
-	for (i = 0; i < KEY_STATE_MAX_LENGTH; ++i) {
-		if (0 == key_sym && 0 == key_code && key_state_array[i].key_sym == 0) {
-			break;
-		}
-		if (key_sym != 0 && (key_state_array[i].key_sym == key_sym
-			|| key_state_array[i].alt_sym == key_sym)) {
-			break;
-		}
-		if (update && key_state_array[i].key_code == key_code) {
-			key_state_array[i].alt_sym = key_sym;
-			break;
-		}
-		if (key_sym == 0 && key_code != 0 && key_state_array[i].key_code == key_code) {
-			break;
-		}
-	}
-	return i;
-}
-
-bool check_key(uint32_t key_sym, uint32_t key_code) {
-	return find_key(key_sym, key_code, false) < KEY_STATE_MAX_LENGTH;
-}
-
-bool check_released_key(uint32_t key_sym) {
-	return (key_sym != 0
-		&& (last_released.key_sym == key_sym
-		|| last_released.alt_sym == key_sym));
-}
-
-void press_key(uint32_t key_sym, uint32_t key_code) {
-	if (key_code == 0) {
-		return;
-	}
-	// Check if key exists
-	if (!check_key(key_sym, key_code)) {
-		// Check that we don't exceed buffer length
-		int insert = find_key(0, 0, true);
-		if (insert < KEY_STATE_MAX_LENGTH) {
-			key_state_array[insert].key_sym = key_sym;
-			key_state_array[insert].key_code = key_code;
-		}
-	}
-}
-
-void release_key(uint32_t key_sym, uint32_t key_code) {
-	uint8_t index = find_key(key_sym, key_code, true);
-	if (index < KEY_STATE_MAX_LENGTH) {
-		last_released.key_sym = key_state_array[index].key_sym;
-		last_released.alt_sym = key_state_array[index].alt_sym;
-		last_released.key_code = key_state_array[index].key_code;
-		struct key_state none = { 0, 0, 0 };
-		key_state_array[index] = none;
-	}
-}
-
 // Pointer state and mode
 
 struct pointer_state pointer_state;
@@ -148,6 +38,13 @@ static struct {
 	bool top;
 } lock;
 
+// Motion in a pointer mode is only applied once per frame
+static struct {
+	bool pending;
+	// motion events and applied updates since the mode was set
+	unsigned int events, updates;
+} motion;
+
 // initial set/unset
 
 static void set_initial_view(swayc_t *view) {
@@ -282,9 +179,21 @@ static void pointer_mode_set_resizing(void) {
 	}
 }
 
+static void pointer_mode_log_motion(void) {
+	if (motion.events) {
+		sway_log(L_DEBUG, "Pointer mode ended: %u motion events coalesced into %u updates",
+				motion.events, motion.updates);
+	}
+	motion.pending = false;
+	motion.events = motion.updates = 0;
+}
+
 // Mode set/update/reset
 
 void pointer_mode_set(uint32_t button, bool condition) {
+	// apply the last position before the button can end the mode
+	pointer_mode_flush();
+	int mode = pointer_state.mode;
 	// switch on drag/resize mode
 	switch (pointer_state.mode & (M_DRAGGING | M_RESIZING)) {
 	case M_DRAGGING:
@@ -339,9 +248,32 @@ void pointer_mode_set(uint32_t button, bool condition) {
 			break;
 		}
 	}
+	if (mode && !pointer_state.mode) {
+		pointer_mode_log_motion();
+	}
 }
 
 void pointer_mode_update(void) {
+	++motion.events;
+	if (motion.pending) {
+		return;
+	}
+	motion.pending = true;
+	swayc_t *output = swayc_active_output();
+	if (output) {
+		wlc_output_schedule_render(output->handle);
+	}
+}
+
+void pointer_mode_flush(void) {
+	if (!motion.pending) {
+		return;
+	}
+	motion.pending = false;
+	if (!pointer_state.mode) {
+		return;
+	}
+	++motion.updates;
 	if (initial.ptr->type != C_VIEW) {
 		pointer_state.mode = 0;
 		return;
@@ -476,6 +408,9 @@ void pointer_mode_update(void) {
 }
 
 void pointer_mode_reset(void) {
+	if (pointer_state.mode) {
+		pointer_mode_log_motion();
+	}
 	switch (pointer_state.mode) {
 	case M_FLOATING | M_RESIZING:
 	case M_FLOATING | M_DRAGGING:
@@ -463,6 +463,7 @@ void ipc_client_handle_command(struct ipc_client *client) {
 			goto exit_denied;
 		}
 		json_object *marks = json_object_new_array();
+		// in tree order, which the mark index doesn't keep
 		container_map(&root_container, ipc_get_marks_callback, marks);
 		const char *json_string = json_object_to_json_string(marks);
 		ipc_send_reply(client, json_string, (uint32_t) strlen(json_string));
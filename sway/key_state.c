@@ -0,0 +1,164 @@
+#include <string.h>
+#include <stdbool.h>
+#include "sway/input_state.h"
+
+// Key codes are evdev codes, KEY_MAX is 0x2ff
+#define KEY_CODE_MAX 0x300
+// Maximum number of distinct key syms held at once, must be a power of two
+#define KEY_SYM_TABLE_SIZE 64
+
+struct key_state {
+	/*
+	 * Aims to store state regardless of modifiers.
+	 * If you press a key, then hold shift, then release the key, we'll
+	 * get two different key syms, but the same key code. This handles
+	 * that scenario and makes sure we can use the right bindings.
+	 */
+	uint32_t key_sym;
+	uint32_t alt_sym;
+	uint32_t key_code;
+};
+
+// Pressed keys, indexed by key code
+static uint32_t key_sym_by_code[KEY_CODE_MAX];
+static uint32_t pressed_codes[KEY_CODE_MAX / 32];
+
+// Open addressed set of the key syms of all pressed keys, each with the
+// number of pressed keys producing it
+static struct {
+	uint32_t key_sym;
+	int count;
+} pressed_syms[KEY_SYM_TABLE_SIZE];
+static int pressed_sym_count;
+
+static struct key_state last_released;
+
+static uint32_t modifiers_state;
+
+void input_init(void) {
+	memset(key_sym_by_code, 0, sizeof(key_sym_by_code));
+	memset(pressed_codes, 0, sizeof(pressed_codes));
+	memset(pressed_syms, 0, sizeof(pressed_syms));
+	pressed_sym_count = 0;
+
+	struct key_state none = { 0, 0, 0 };
+	last_released = none;
+
+	modifiers_state = 0;
+}
+
+uint32_t modifier_state_changed(uint32_t new_state, uint32_t mod) {
+	if ((new_state & mod) != 0) { // pressed
+		if ((modifiers_state & mod) != 0) { // already pressed
+			return MOD_STATE_UNCHANGED;
+		} else { // pressed
+			return MOD_STATE_PRESSED;
+		}
+	} else { // not pressed
+		if ((modifiers_state & mod) != 0) { // released
+			return MOD_STATE_RELEASED;
+		} else { // already released
+			return MOD_STATE_UNCHANGED;
+		}
+	}
+}
+
+void modifiers_state_update(uint32_t new_state) {
+	modifiers_state = new_state;
+}
+
+static bool code_pressed(uint32_t key_code) {
+	return key_code < KEY_CODE_MAX
+		&& (pressed_codes[key_code / 32] & (1U << (key_code % 32))) != 0;
+}
+
+// Returns the slot holding key_sym, or the free slot it would go in. The
+// table never fills up since press_key() refuses to insert into the last
+// free slot.
+static int find_sym(uint32_t key_sym) {
+	int i = key_sym & (KEY_SYM_TABLE_SIZE - 1);
+	while (pressed_syms[i].count && pressed_syms[i].key_sym != key_sym) {
+		i = (i + 1) & (KEY_SYM_TABLE_SIZE - 1);
+	}
+	return i;
+}
+
+static bool ref_sym(uint32_t key_sym) {
+	int i = find_sym(key_sym);
+	if (!pressed_syms[i].count) {
+		if (pressed_sym_count == KEY_SYM_TABLE_SIZE - 1) {
+			return false;
+		}
+		pressed_sym_count++;
+		pressed_syms[i].key_sym = key_sym;
+	}
+	pressed_syms[i].count++;
+	return true;
+}
+
+static void unref_sym(uint32_t key_sym) {
+	int i = find_sym(key_sym);
+	if (!pressed_syms[i].count || --pressed_syms[i].count) {
+		return;
+	}
+	pressed_sym_count--;
+	// Shift following entries of the probe sequence back into the hole
+	int j = i;
+	for (;;) {
+		j = (j + 1) & (KEY_SYM_TABLE_SIZE - 1);
+		if (!pressed_syms[j].count) {
+			break;
+		}
+		int home = pressed_syms[j].key_sym & (KEY_SYM_TABLE_SIZE - 1);
+		if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+			pressed_syms[i] = pressed_syms[j];
+			pressed_syms[j].count = 0;
+			i = j;
+		}
+	}
+}
+
+bool check_key(uint32_t key_sym, uint32_t key_code) {
+	if (key_sym != 0) {
+		return pressed_syms[find_sym(key_sym)].count > 0;
+	}
+	return code_pressed(key_code);
+}
+
+bool check_released_key(uint32_t key_sym) {
+	return (key_sym != 0
+		&& (last_released.key_sym == key_sym
+		|| last_released.alt_sym == key_sym));
+}
+
+void get_released_key(uint32_t *key_sym, uint32_t *alt_sym) {
+	*key_sym = last_released.key_sym;
+	*alt_sym = last_released.alt_sym;
+}
+
+void press_key(uint32_t key_sym, uint32_t key_code) {
+	if (key_code == 0 || key_code >= KEY_CODE_MAX || code_pressed(key_code)) {
+		return;
+	}
+	if (key_sym != 0 && !ref_sym(key_sym)) {
+		return;
+	}
+	key_sym_by_code[key_code] = key_sym;
+	pressed_codes[key_code / 32] |= 1U << (key_code % 32);
+}
+
+void release_key(uint32_t key_sym, uint32_t key_code) {
+	if (!code_pressed(key_code)) {
+		return;
+	}
+	last_released.key_code = key_code;
+	last_released.key_sym = key_sym_by_code[key_code];
+	// the key sym may have changed while the key was held, remember both
+	last_released.alt_sym = key_sym != last_released.key_sym ? key_sym : 0;
+
+	if (last_released.key_sym != 0) {
+		unref_sym(last_released.key_sym);
+	}
+	key_sym_by_code[key_code] = 0;
+	pressed_codes[key_code / 32] &= ~(1U << (key_code % 32));
+}
@@ -63,6 +63,7 @@ void add_child(swayc_t *parent, swayc_t *child) {
 		child->width, child->height, parent, parent->type, parent->width, parent->height);
 	list_add(parent->children, child);
 	child->parent = parent;
+	invalidate_container_index();
 	// set focus for this container
 	if (!parent->focused) {
 		parent->focused = child;
@@ -89,6 +90,7 @@ void insert_child(swayc_t *parent, swayc_t *child, int index) {
 	}
 	list_insert(parent->children, index, child);
 	child->parent = parent;
+	invalidate_container_index();
 	if (!parent->focused) {
 		parent->focused = child;
 	}
@@ -144,6 +146,7 @@ void add_floating(swayc_t *ws, swayc_t *child) {
 	list_add(ws->floating, child);
 	child->parent = ws;
 	child->is_floating = true;
+	invalidate_container_index();
 	if (!ws->focused) {
 		ws->focused = child;
 	}
@@ -152,6 +155,7 @@ void add_floating(swayc_t *ws, swayc_t *child) {
 
 swayc_t *add_sibling(swayc_t *fixed, swayc_t *active) {
 	swayc_t *parent = fixed->parent;
+	invalidate_container_index();
 	if (fixed->is_floating) {
 		if (active->is_floating) {
 			int i = index_child(fixed);
@@ -182,6 +186,7 @@ swayc_t *replace_child(swayc_t *child, swayc_t *new_child) {
 	if (parent == NULL) {
 		return NULL;
 	}
+	invalidate_container_index();
 	int i = index_child(child);
 	if (child->is_floating) {
 		parent->floating->items[i] = new_child;
@@ -215,6 +220,7 @@ swayc_t *replace_child(swayc_t *child, swayc_t *new_child) {
 swayc_t *remove_child(swayc_t *child) {
 	int i;
 	swayc_t *parent = child->parent;
+	invalidate_container_index();
 	if (child->is_floating) {
 		// Special case for floating views
 		for (i = 0; i < parent->floating->length; ++i) {
@@ -291,6 +297,7 @@ void swap_container(swayc_t *a, swayc_t *b) {
 		!sway_assert(a->parent && b->parent, "containers must have parents")) {
 		return;
 	}
+	invalidate_container_index();
 	size_t a_index = index_child(a);
 	size_t b_index = index_child(b);
 	swayc_t *a_parent = a->parent;
@@ -318,6 +325,7 @@ void swap_container(swayc_t *a, swayc_t *b) {
 }
 
 void swap_geometry(swayc_t *a, swayc_t *b) {
+	invalidate_container_index();
 	double x = a->x;
 	double y = a->y;
 	double w = a->width;
@@ -336,6 +344,7 @@ static void swap_children(swayc_t *container, int a, int b) {
 	if (a >= 0 && b >= 0 && a < container->children->length
 			&& b < container->children->length
 		&& a != b) {
+		invalidate_container_index();
 		swayc_t *pa = (swayc_t *)container->children->items[a];
 		swayc_t *pb = (swayc_t *)container->children->items[b];
 		container->children->items[a] = container->children->items[b];
@@ -748,6 +757,7 @@ void update_geometry(swayc_t *container) {
 	if (container->type != C_VIEW && container->type != C_CONTAINER) {
 		return;
 	}
+	invalidate_container_index();
 
 	swayc_t *workspace = swayc_parent_by_type(container, C_WORKSPACE);
 	swayc_t *op = workspace->parent;
@@ -1027,6 +1037,13 @@ static void arrange_windows_r(swayc_t *container, double width, double height) {
 			y = container->y = y + gap;
 			width = container->width = width - gap * 2;
 			height = container->height = height - gap * 2;
+			if (!container->visible) {
+				// Geometry and borders of hidden workspaces are computed
+				// once they are shown
+				container->layout_stale = true;
+				return;
+			}
+			container->layout_stale = false;
 			sway_log(L_DEBUG, "Arranging workspace '%s' at %f, %f", container->name, container->x, container->y);
 		}
 		// children are properly handled below
@@ -1374,6 +1391,8 @@ void apply_auto_layout(swayc_t *container, const double x, const double y,
 }
 
 void arrange_windows(swayc_t *container, double width, double height) {
+	invalidate_container_index();
+	invalidate_output_neighbors();
 	update_visibility(container);
 	arrange_windows_r(container, width, height);
 	layout_log(&root_container, 0);
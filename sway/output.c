@@ -2,8 +2,70 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include "sway/output.h"
+#include "sway/config.h"
+#include "sway/layout.h"
 #include "log.h"
 #include "list.h"
+#include "hash.h"
+
+// Outputs aligned with each edge of an output, in root container order.
+// Indexed by MOVE_LEFT, MOVE_RIGHT, MOVE_UP and MOVE_DOWN.
+struct output_neighbors {
+	list_t *edges[4];
+};
+
+static hash_t *output_neighbors = NULL;
+static bool output_neighbors_valid = false;
+
+// Outputs are settled this long after the last hotplug event
+#define OUTPUT_SETTLE_DELAY 200
+
+static struct wlc_event_source *output_settle_timer = NULL;
+static int output_changes = 0;
+// what the settle has to do besides arranging
+static bool respawn_swaybars = false;
+static bool reload_swaybg = false;
+
+static int output_settle(void *data) {
+	if (output_changes == 0) {
+		return 0;
+	}
+	sway_log(L_DEBUG, "Outputs settled after %d changes", output_changes);
+	output_changes = 0;
+	if (respawn_swaybars) {
+		respawn_swaybars = false;
+		load_swaybars();
+	}
+	if (reload_swaybg) {
+		reload_swaybg = false;
+		load_swaybg();
+	}
+	arrange_windows(&root_container, -1, -1);
+	return 0;
+}
+
+void schedule_output_settle(enum output_change change) {
+	++output_changes;
+	switch (change) {
+	case OUTPUT_ADDED:
+		respawn_swaybars = true;
+		reload_swaybg = true;
+		break;
+	case OUTPUT_REMOVED:
+		reload_swaybg = true;
+		break;
+	case OUTPUT_RESIZED:
+		break;
+	}
+	if (!output_settle_timer) {
+		output_settle_timer = wlc_event_loop_add_timer(output_settle, NULL);
+	}
+	if (!output_settle_timer
+			|| !wlc_event_source_timer_update(output_settle_timer, OUTPUT_SETTLE_DELAY)) {
+		sway_log(L_ERROR, "Unable to schedule output settle timer");
+		output_settle(NULL);
+	}
+}
 
 void output_get_scaled_size(wlc_handle handle, struct wlc_size *size) {
 	*size = *wlc_output_get_resolution(handle);
@@ -98,6 +160,80 @@ swayc_t *swayc_opposite_output(enum movement_direction dir,
 	return opposite;
 }
 
+static void free_output_neighbors(const void *key, void *value, void *data) {
+	struct output_neighbors *neighbors = value;
+	for (int i = 0; i < 4; ++i) {
+		list_free(neighbors->edges[i]);
+	}
+	free(neighbors);
+}
+
+void invalidate_output_neighbors(void) {
+	output_neighbors_valid = false;
+}
+
+static bool outputs_aligned(swayc_t *output, swayc_t *c, enum movement_direction dir) {
+	switch (dir) {
+	case MOVE_LEFT:
+		return c->x + c->width == output->x;
+	case MOVE_RIGHT:
+		return c->x == output->x + output->width;
+	case MOVE_UP:
+		return c->y + c->height == output->y;
+	case MOVE_DOWN:
+		return c->y == output->y + output->height;
+	default:
+		return false;
+	}
+}
+
+static void build_output_neighbors(void) {
+	if (!output_neighbors) {
+		output_neighbors = create_hash(hash_pointer, hash_pointer_cmp);
+		if (!output_neighbors) {
+			return;
+		}
+	}
+	hash_foreach(output_neighbors, free_output_neighbors, NULL);
+	hash_clear(output_neighbors);
+	for (int i = 0; i < root_container.children->length; ++i) {
+		swayc_t *output = root_container.children->items[i];
+		if (output->type != C_OUTPUT) {
+			continue;
+		}
+		struct output_neighbors *neighbors = malloc(sizeof(struct output_neighbors));
+		if (!neighbors) {
+			return;
+		}
+		for (int dir = MOVE_LEFT; dir <= MOVE_DOWN; ++dir) {
+			neighbors->edges[dir] = create_list();
+			for (int j = 0; j < root_container.children->length; ++j) {
+				swayc_t *c = root_container.children->items[j];
+				if (c != output && c->type == C_OUTPUT && outputs_aligned(output, c, dir)) {
+					list_add(neighbors->edges[dir], c);
+				}
+			}
+		}
+		hash_set(output_neighbors, output, neighbors);
+	}
+	output_neighbors_valid = true;
+}
+
+static list_t *get_output_neighbors(swayc_t *output, enum movement_direction dir) {
+	if (!output_neighbors_valid) {
+		build_output_neighbors();
+	}
+	struct output_neighbors *neighbors = NULL;
+	if (output_neighbors_valid) {
+		neighbors = hash_get(output_neighbors, output);
+	}
+	if (!neighbors) {
+		// Not laid out yet (or out of memory), fall back to all outputs
+		return root_container.children;
+	}
+	return neighbors->edges[dir];
+}
+
 // Position is where on the edge (as absolute position) the adjacent output should be searched for.
 swayc_t *swayc_adjacent_output(swayc_t *output, enum movement_direction dir,
 		const struct wlc_point *abs_pos, bool pick_closest) {
@@ -105,6 +241,10 @@ swayc_t *swayc_adjacent_output(swayc_t *output, enum movement_direction dir,
 	if (!output) {
 		output = swayc_active_output();
 	}
+	if (dir > MOVE_DOWN) {
+		sway_abort("Function called with invalid argument.");
+	}
+	list_t *candidates = get_output_neighbors(output, dir);
 	// In order to find adjacent outputs we need to test that the outputs are
 	// aligned on one axis (decided by the direction given) and that the given
 	// position is within the edge of the adjacent output. If no such output
@@ -116,8 +256,8 @@ swayc_t *swayc_adjacent_output(swayc_t *output, enum movement_direction dir,
 		case MOVE_LEFT:
 		case MOVE_RIGHT: ;
 			double delta_y = 0;
-			for(int i = 0; i < root_container.children->length; ++i) {
-				swayc_t *c = root_container.children->items[i];
+			for(int i = 0; i < candidates->length; ++i) {
+				swayc_t *c = candidates->items[i];
 				if (c == output || c->type != C_OUTPUT) {
 					continue;
 				}
@@ -169,8 +309,8 @@ swayc_t *swayc_adjacent_output(swayc_t *output, enum movement_direction dir,
 		case MOVE_UP:
 		case MOVE_DOWN: ;
 			double delta_x = 0;
-			for(int i = 0; i < root_container.children->length; ++i) {
-				swayc_t *c = root_container.children->items[i];
+			for(int i = 0; i < candidates->length; ++i) {
+				swayc_t *c = candidates->items[i];
 				if (c == output || c->type != C_OUTPUT) {
 					continue;
 				}
@@ -254,9 +394,7 @@ void get_absolute_center_position(swayc_t *container, struct wlc_point *point) {
 	point->y += container->height/2;
 }
 
-static int sort_workspace_cmp_qsort(const void *_a, const void *_b) {
-	swayc_t *a = *(void **)_a;
-	swayc_t *b = *(void **)_b;
+static int workspace_cmp(swayc_t *a, swayc_t *b) {
 	int retval = 0;
 
 	if (isdigit(a->name[0]) && isdigit(b->name[0])) {
@@ -272,6 +410,25 @@ static int sort_workspace_cmp_qsort(const void *_a, const void *_b) {
 	return retval;
 }
 
+static int sort_workspace_cmp_qsort(const void *_a, const void *_b) {
+	return workspace_cmp(*(void **)_a, *(void **)_b);
+}
+
 void sort_workspaces(swayc_t *output) {
 	list_stable_sort(output->children, sort_workspace_cmp_qsort);
 }
+
+int workspace_sort_index(swayc_t *output, swayc_t *workspace) {
+	// The workspaces of an output are always sorted, so insert after the
+	// last one not ordered after the new workspace
+	int lo = 0, hi = output->children->length;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (workspace_cmp(output->children->items[mid], workspace) <= 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
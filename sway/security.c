@@ -8,6 +8,9 @@
 #include "sway/security.h"
 #include "log.h"
 
+// Bumped whenever the policies change, invalidating what views cached
+static unsigned int policy_generation = 1;
+
 static bool validate_ipc_target(const char *program) {
 	struct stat sb;
 
@@ -70,6 +73,13 @@ struct feature_policy *alloc_feature_policy(const char *program) {
 	return policy;
 }
 
+void invalidate_policy_cache(void) {
+	policy_generation++;
+	if (policy_generation == 0) {
+		policy_generation = 1;
+	}
+}
+
 struct ipc_policy *alloc_ipc_policy(const char *program) {
 	uint32_t default_policy = 0;
 
@@ -118,15 +128,12 @@ static const char *get_pid_exe(pid_t pid) {
 #else
 	const char *fmt = "/proc/%d/exe";
 #endif
-	int pathlen = snprintf(NULL, 0, fmt, pid);
-	char *path = malloc(pathlen + 1);
-	if (path) {
-		snprintf(path, pathlen + 1, fmt, pid);
-	}
+	char path[32];
+	snprintf(path, sizeof(path), fmt, pid);
 
 	static char link[2048];
 
-	ssize_t len = !path ? -1 : readlink(path, link, sizeof(link));
+	ssize_t len = readlink(path, link, sizeof(link) - 1);
 	if (len < 0) {
 		sway_log(L_INFO,
 			"WARNING: unable to read %s for security check. Using default policy.",
@@ -135,79 +142,58 @@ static const char *get_pid_exe(pid_t pid) {
 	} else {
 		link[len] = '\0';
 	}
-	free(path);
 
 	return link;
 }
 
 struct feature_policy *get_feature_policy(const char *name) {
-	struct feature_policy *policy = NULL;
-
-	for (int i = 0; i < config->feature_policies->length; ++i) {
-		struct feature_policy *p = config->feature_policies->items[i];
-		if (strcmp(p->program, name) == 0) {
-			policy = p;
-			break;
-		}
-	}
+	struct feature_policy *policy = hash_get(config->feature_policy_index, name);
 	if (!policy) {
 		policy = alloc_feature_policy(name);
 		if (!policy) {
 			sway_abort("Unable to allocate security policy");
 		}
 		list_add(config->feature_policies, policy);
+		hash_set(config->feature_policy_index, policy->program, policy);
 	}
+	invalidate_policy_cache();
 	return policy;
 }
 
 uint32_t get_feature_policy_mask(pid_t pid) {
-	uint32_t default_policy = 0;
 	const char *link = get_pid_exe(pid);
 
-	for (int i = 0; i < config->feature_policies->length; ++i) {
-		struct feature_policy *policy = config->feature_policies->items[i];
-		if (strcmp(policy->program, "*") == 0) {
-			default_policy = policy->features;
-		}
-		if (strcmp(policy->program, link) == 0) {
-			return policy->features;
-		}
+	struct feature_policy *policy = hash_get(config->feature_policy_index, link);
+	if (!policy) {
+		policy = hash_get(config->feature_policy_index, "*");
 	}
+	return policy ? policy->features : 0;
+}
 
-	return default_policy;
+uint32_t get_view_feature_policy_mask(swayc_t *view) {
+	if (view->feature_policy_generation != policy_generation) {
+		view->feature_policy = get_feature_policy_mask(wlc_view_get_pid(view->handle));
+		view->feature_policy_generation = policy_generation;
+	}
+	return view->feature_policy;
 }
 
 uint32_t get_ipc_policy_mask(pid_t pid) {
-	uint32_t default_policy = 0;
 	const char *link = get_pid_exe(pid);
 
-	for (int i = 0; i < config->ipc_policies->length; ++i) {
-		struct ipc_policy *policy = config->ipc_policies->items[i];
-		if (strcmp(policy->program, "*") == 0) {
-			default_policy = policy->features;
-		}
-		if (strcmp(policy->program, link) == 0) {
-			return policy->features;
-		}
+	struct ipc_policy *policy = hash_get(config->ipc_policy_index, link);
+	if (!policy) {
+		policy = hash_get(config->ipc_policy_index, "*");
 	}
-
-	return default_policy;
+	return policy ? policy->features : 0;
 }
 
 uint32_t get_command_policy_mask(const char *cmd) {
-	uint32_t default_policy = 0;
-
-	for (int i = 0; i < config->command_policies->length; ++i) {
-		struct command_policy *policy = config->command_policies->items[i];
-		if (strcmp(policy->command, "*") == 0) {
-			default_policy = policy->context;
-		}
-		if (strcmp(policy->command, cmd) == 0) {
-			return policy->context;
-		}
+	struct command_policy *policy = hash_get(config->command_policy_index, cmd);
+	if (!policy) {
+		policy = hash_get(config->command_policy_index, "*");
 	}
-
-	return default_policy;
+	return policy ? policy->context : 0;
 }
 
 const char *command_policy_str(enum command_context context) {
@@ -6,6 +6,8 @@
 #include <wlc/wlc.h>
 #include <string.h>
 #include <strings.h>
+#include <stdint.h>
+#include <time.h>
 #include <sys/types.h>
 #include "sway/ipc-server.h"
 #include "sway/extensions.h"
@@ -16,18 +18,97 @@
 #include "sway/config.h"
 #include "sway/focus.h"
 #include "stringop.h"
+#include "hash.h"
 #include "util.h"
 #include "list.h"
 #include "log.h"
 #include "ipc.h"
 
 char *prev_workspace_name = NULL;
-struct workspace_by_number_data {
-	int len;
-	const char *cset;
-	const char *name;
+
+#define WORKSPACE_NUMBER_CHARS "1234567890"
+
+// Workspaces by name, case insensitive. Keys are the workspace names.
+static hash_t *workspace_name_index = NULL;
+// Workspaces by the digits their name starts with, in creation order
+static hash_t *workspace_number_index = NULL;
+
+struct workspace_number {
+	char *number;
+	list_t *workspaces;
 };
 
+void index_workspace(swayc_t *workspace) {
+	if (!workspace->name) {
+		return;
+	}
+	if (!workspace_name_index && !(workspace_name_index =
+				create_hash(hash_string_nocase, hash_string_casecmp))) {
+		sway_log(L_ERROR, "Unable to allocate workspace index");
+		return;
+	}
+	if (!hash_get(workspace_name_index, workspace->name)) {
+		hash_set(workspace_name_index, workspace->name, workspace);
+	}
+
+	int len = strspn(workspace->name, WORKSPACE_NUMBER_CHARS);
+	if (len <= 0) {
+		return;
+	}
+	if (!workspace_number_index && !(workspace_number_index =
+				create_hash(hash_string, hash_string_cmp))) {
+		sway_log(L_ERROR, "Unable to allocate workspace index");
+		return;
+	}
+	char number[len + 1];
+	strncpy(number, workspace->name, len);
+	number[len] = '\0';
+	struct workspace_number *entry = hash_get(workspace_number_index, number);
+	if (!entry) {
+		if (!(entry = malloc(sizeof(struct workspace_number)))) {
+			return;
+		}
+		entry->number = strdup(number);
+		entry->workspaces = create_list();
+		hash_set(workspace_number_index, entry->number, entry);
+	}
+	list_add(entry->workspaces, workspace);
+}
+
+void unindex_workspace(swayc_t *workspace) {
+	if (!workspace->name) {
+		return;
+	}
+	if (workspace_name_index
+			&& hash_get(workspace_name_index, workspace->name) == workspace) {
+		hash_del(workspace_name_index, workspace->name);
+	}
+
+	int len = strspn(workspace->name, WORKSPACE_NUMBER_CHARS);
+	if (len <= 0 || !workspace_number_index) {
+		return;
+	}
+	char number[len + 1];
+	strncpy(number, workspace->name, len);
+	number[len] = '\0';
+	struct workspace_number *entry = hash_get(workspace_number_index, number);
+	if (!entry) {
+		return;
+	}
+	for (int i = 0; i < entry->workspaces->length; ++i) {
+		if (entry->workspaces->items[i] == workspace) {
+			list_del(entry->workspaces, i);
+			break;
+		}
+	}
+	if (entry->workspaces->length == 0) {
+		hash_del(workspace_number_index, entry->number);
+		list_free(entry->workspaces);
+		free(entry->number);
+		free(entry);
+	}
+}
+
 static bool workspace_valid_on_output(const char *output_name, const char *ws_name) {
 	int i;
 	for (i = 0; i < config->workspace_outputs->length; ++i) {
@@ -46,72 +127,18 @@ char *workspace_next_name(const char *output_name) {
 	sway_log(L_DEBUG, "Workspace: Generating new workspace name for output %s", output_name);
 	int i;
 	int l = 1;
-	// Scan all workspace bindings to find the next available workspace name,
-	// if none are found/available then default to a number
-	struct sway_mode *mode = config->current_mode;
-
-	int order = INT_MAX;
-	char *target = NULL;
-	for (i = 0; i < mode->bindings->length; ++i) {
-		struct sway_binding *binding = mode->bindings->items[i];
-		char *cmdlist = strdup(binding->command);
-		char *dup = cmdlist;
-		char *name = NULL;
-
-		// workspace n
-		char *cmd = argsep(&cmdlist, " ");
-		if (cmdlist) {
-			name = argsep(&cmdlist, " ,;");
-		}
-
-		if (strcmp("workspace", cmd) == 0 && name) {
-			sway_log(L_DEBUG, "Got valid workspace command for target: '%s'", name);
-			char *_target = strdup(name);
-			strip_quotes(_target);
-			while (isspace(*_target))
-				_target++;
-
-			// Make sure that the command references an actual workspace
-			// not a command about workspaces
-			if (strcmp(_target, "next") == 0 ||
-				strcmp(_target, "prev") == 0 ||
-				strcmp(_target, "next_on_output") == 0 ||
-				strcmp(_target, "prev_on_output") == 0 ||
-				strcmp(_target, "number") == 0 ||
-				strcmp(_target, "back_and_forth") == 0 ||
-				strcmp(_target, "current") == 0)
-			{
-				free(_target);
-				free(dup);
-				continue;
-			}
-
-			// Make sure that the workspace doesn't already exist
-			if (workspace_by_name(_target)) {
-				free(_target);
-				free(dup);
-				continue;
-			}
-
-			// make sure that the workspace can appear on the given
-			// output
-			if (!workspace_valid_on_output(output_name, _target)) {
-				free(_target);
-				free(dup);
-				continue;
-			}
-
-			if (binding->order < order) {
-				order = binding->order;
-				free(target);
-				target = _target;
-				sway_log(L_DEBUG, "Workspace: Found free name %s", _target);
-			}
+	// Take the first workspace bindings switch to that is available, if none
+	// are found/available then default to a number
+	list_t *names = get_binding_workspace_names(config->current_mode);
+	for (i = 0; names && i < names->length; ++i) {
+		const char *name = names->items[i];
+		// Make sure that the workspace doesn't already exist and that it
+		// can appear on the given output
+		if (workspace_by_name(name) || !workspace_valid_on_output(output_name, name)) {
+			continue;
 		}
-		free(dup);
-	}
-	if (target != NULL) {
-		return target;
+		sway_log(L_DEBUG, "Workspace: Found free name %s", name);
+		return strdup(name);
 	}
 	// As a fall back, get the current number of active workspaces
 	// and return that + 1 for the next workspace's name
@@ -155,11 +182,6 @@ swayc_t *workspace_create(const char* name) {
 	return new_workspace(parent, name);
 }
 
-static bool _workspace_by_name(swayc_t *view, void *data) {
-	return (view->type == C_WORKSPACE) &&
-		   (strcasecmp(view->name, (char *) data) == 0);
-}
-
 swayc_t *workspace_by_name(const char* name) {
 	if (strcmp(name, "prev") == 0) {
 		return workspace_prev();
@@ -177,25 +199,40 @@ swayc_t *workspace_by_name(const char* name) {
 		return swayc_active_workspace();
 	}
 	else {
-		return swayc_by_test(&root_container, _workspace_by_name, (void *) name);
+		return workspace_name_index ? hash_get(workspace_name_index, name) : NULL;
 	}
 }
 
-static bool _workspace_by_number(swayc_t *view, void *data) {
-	if (view->type != C_WORKSPACE) {
-		return false;
-	}
-	struct workspace_by_number_data *wbnd = data;
-	int a = strspn(view->name, wbnd->cset);
-	return a == wbnd->len && strncmp(view->name, wbnd->name, a) == 0;
-}
 swayc_t *workspace_by_number(const char* name) {
-	struct workspace_by_number_data wbnd = {0, "1234567890", name};
-	wbnd.len = strspn(name, wbnd.cset);
-	if (wbnd.len <= 0) {
+	int len = strspn(name, WORKSPACE_NUMBER_CHARS);
+	if (len <= 0 || !workspace_number_index) {
+		return NULL;
+	}
+	char number[len + 1];
+	strncpy(number, name, len);
+	number[len] = '\0';
+	struct workspace_number *entry = hash_get(workspace_number_index, number);
+	if (!entry) {
 		return NULL;
 	}
-	return swayc_by_test(&root_container, _workspace_by_number, (void *) &wbnd);
+	// Several workspaces can share a number, pick the first in tree order
+	swayc_t *first = NULL;
+	int first_output = 0, first_index = 0;
+	for (int i = 0; i < entry->workspaces->length; ++i) {
+		swayc_t *ws = entry->workspaces->items[i];
+		if (!ws->parent) {
+			continue;
+		}
+		int output = index_child(ws->parent);
+		int index = index_child(ws);
+		if (!first || output < first_output
+				|| (output == first_output && index < first_index)) {
+			first = ws;
+			first_output = output;
+			first_index = index;
+		}
+	}
+	return first ? first : entry->workspaces->items[0];
 }
 
 /**
@@ -322,42 +359,57 @@ bool workspace_switch(swayc_t *workspace) {
 	return true;
 }
 
+// A process is reparented when its parent exits, so resolved parents are only
+// trusted for a couple of seconds before the whole cache is dropped
+#define PARENT_PID_CACHE_TIMEOUT 2
+
+static hash_t *parent_pids = NULL;
+static time_t parent_pids_time = 0;
+
+// get_parent_pid reads /proc/<pid>/stat, remember what it returned so views
+// spawned in a burst from the same tree don't walk /proc all over again
+static pid_t cached_parent_pid(pid_t pid) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	if (!parent_pids && !(parent_pids = create_hash(hash_pointer, hash_pointer_cmp))) {
+		return get_parent_pid(pid);
+	}
+	if (ts.tv_sec - parent_pids_time >= PARENT_PID_CACHE_TIMEOUT) {
+		hash_clear(parent_pids);
+		parent_pids_time = ts.tv_sec;
+	}
+	// get_parent_pid never returns 0, so a NULL value is a miss
+	void *parent = hash_get(parent_pids, (void *)(intptr_t)pid);
+	if (!parent) {
+		parent = (void *)(intptr_t)get_parent_pid(pid);
+		hash_set(parent_pids, (void *)(intptr_t)pid, parent);
+	}
+	return (pid_t)(intptr_t)parent;
+}
+
 swayc_t *workspace_for_pid(pid_t pid) {
-	int i;
 	swayc_t *ws = NULL;
 	struct pid_workspace *pw = NULL;
 
 	sway_log(L_DEBUG, "looking for workspace for pid %d", pid);
 
-	// leaving this here as it's useful for debugging
-	// sway_log(L_DEBUG, "all pid_workspaces");
-	// for (int k = 0; k < config->pid_workspaces->length; k++) {
-	// 	pw = config->pid_workspaces->items[k];
-	// 	sway_log(L_DEBUG, "pid %d workspace %s time_added %li", *pw->pid, pw->workspace, *pw->time_added);
-	// }
+	if (config->pid_workspaces->length == 0) {
+		// nothing was started from a workspace, no need to walk the tree
+		return NULL;
+	}
 
+	pid_t self = getpid();
 	do {
-		for (i = 0; i < config->pid_workspaces->length; i++) {
-			pw = config->pid_workspaces->items[i];
-			pid_t *pw_pid = pw->pid;
-
-			if (pid == *pw_pid) {
-				sway_log(L_DEBUG, "found pid_workspace for pid %d, workspace %s", pid, pw->workspace);
-				break; // out of for loop
-			}
-
-			pw = NULL;
-		}
-
-		if (pw) {
-			break; // out of do-while loop
+		if ((pw = pid_workspace_find(pid))) {
+			sway_log(L_DEBUG, "found pid_workspace for pid %d, workspace %s", pid, pw->workspace);
+			break;
 		}
 
-		pid = get_parent_pid(pid);
+		pid = cached_parent_pid(pid);
 		// no sense in looking for matches for pid 0.
 		// also, if pid == getpid(), that is the compositor's
 		// pid, which definitely isn't helpful
-	} while (pid > 0 && pid != getpid());
+	} while (pid > 0 && pid != self);
 
 	if (pw) {
 		ws = workspace_by_name(pw->workspace);
@@ -367,7 +419,7 @@ swayc_t *workspace_for_pid(pid_t pid) {
 			ws = workspace_create(pw->workspace);
 		}
 
-		list_del(config->pid_workspaces, i);
+		pid_workspace_del(pw);
 	}
 
 	return ws;
@@ -56,6 +56,8 @@ struct output *new_output(const char *name) {
 	output->window = NULL;
 	output->registry = NULL;
 	output->workspaces = create_list();
+	output->dirty = false;
+	output->renders_skipped = 0;
 	return output;
 }
 
@@ -180,10 +182,41 @@ void bar_setup(struct bar *bar, const char *socket_path, const char *bar_id) {
 	spawn_status_cmd_proc(bar);
 }
 
+static void bar_mark_dirty(struct bar *bar) {
+	int i;
+	for (i = 0; i < bar->outputs->length; ++i) {
+		struct output *output = bar->outputs->items[i];
+		if (output->dirty) {
+			// an update is already queued for the next frame, fold this one in
+			output->renders_skipped++;
+		}
+		output->dirty = true;
+	}
+}
+
+static void bar_render_dirty(struct bar *bar) {
+	int i;
+	for (i = 0; i < bar->outputs->length; ++i) {
+		struct output *output = bar->outputs->items[i];
+		if (!output->dirty) {
+			continue;
+		}
+		// wait for the frame callback of the last commit before rendering again
+		if (!window_prerender(output->window) || !output->window->cairo) {
+			continue;
+		}
+		render(output, bar->config, bar->status);
+		window_render(output->window);
+		wl_display_flush(output->registry->display);
+		output->dirty = false;
+		sway_log(L_DEBUG, "Rendered output %s (renders skipped: %u)",
+				output->name, output->renders_skipped);
+	}
+}
+
 void bar_run(struct bar *bar) {
 	int pfds = bar->outputs->length + 2;
 	struct pollfd *pfd = malloc(pfds * sizeof(struct pollfd));
-	bool dirty = true;
 
 	pfd[0].fd = bar->ipc_event_socketfd;
 	pfd[0].events = POLLIN;
@@ -197,34 +230,28 @@ void bar_run(struct bar *bar) {
 		pfd[i+2].events = POLLIN;
 	}
 
-	while (1) {
-		if (dirty) {
-			int i;
-			for (i = 0; i < bar->outputs->length; ++i) {
-				struct output *output = bar->outputs->items[i];
-				if (window_prerender(output->window) && output->window->cairo) {
-					render(output, bar->config, bar->status);
-					window_render(output->window);
-					wl_display_flush(output->registry->display);
-				}
-			}
-		}
+	bar_mark_dirty(bar);
 
-		dirty = false;
+	while (1) {
+		bar_render_dirty(bar);
 
 		poll(pfd, pfds, -1);
 
 		if (pfd[0].revents & POLLIN) {
 			sway_log(L_DEBUG, "Got IPC event.");
-			dirty = handle_ipc_event(bar);
+			if (handle_ipc_event(bar)) {
+				bar_mark_dirty(bar);
+			}
 		}
 
 		if (bar->config->status_command && pfd[1].revents & POLLIN) {
 			sway_log(L_DEBUG, "Got update from status command.");
-			dirty = handle_status_line(bar);
+			if (handle_status_line(bar)) {
+				bar_mark_dirty(bar);
+			}
 		}
 
-		// dispatch wl_display events
+		// dispatch wl_display events, this is where frame callbacks arrive
 		for (i = 0; i < bar->outputs->length; ++i) {
 			struct output *output = bar->outputs->items[i];
 			if (pfd[i+2].revents & POLLIN) {
@@ -6,6 +6,7 @@
 #include <wayland-client.h>
 #include <time.h>
 #include <string.h>
+#include "client/background.h"
 #include "client/window.h"
 #include "client/registry.h"
 #include "client/cairo.h"
@@ -16,14 +17,6 @@
 list_t *surfaces;
 struct registry *registry;
 
-enum scaling_mode {
-	SCALING_MODE_STRETCH,
-	SCALING_MODE_FILL,
-	SCALING_MODE_FIT,
-	SCALING_MODE_CENTER,
-	SCALING_MODE_TILE,
-};
-
 void sway_terminate(int exit_code) {
 	int i;
 	for (i = 0; i < surfaces->length; ++i) {
@@ -52,12 +45,65 @@ bool is_valid_color(const char *color) {
 	return true;
 }
 
+struct loaded_image {
+	const char *path;
+	struct background_image *image;
+};
+
+/**
+ * Decodes each distinct image only once, no matter how many outputs show it.
+ */
+static struct background_image *get_image(list_t *images, const char *path) {
+	int i;
+	for (i = 0; i < images->length; ++i) {
+		struct loaded_image *loaded = images->items[i];
+		if (strcmp(loaded->path, path) == 0) {
+			return loaded->image;
+		}
+	}
+	struct loaded_image *loaded = malloc(sizeof(struct loaded_image));
+	loaded->path = path;
+	loaded->image = load_background_image(path);
+	list_add(images, loaded);
+	return loaded->image;
+}
+
+static void render_background(struct window *window, list_t *images,
+		const char *background, const char *scaling_mode_str) {
+	if (!window_prerender(window) || !window->cairo) {
+		return;
+	}
+
+	if (strcmp(scaling_mode_str, "solid_color") == 0 && is_valid_color(background)) {
+		cairo_set_source_u32(window->cairo, parse_color(background));
+		cairo_paint(window->cairo);
+	} else {
+		enum scaling_mode scaling_mode;
+		if (!parse_scaling_mode(scaling_mode_str, &scaling_mode)) {
+			sway_log(L_ERROR, "Unsupported scaling mode: %s", scaling_mode_str);
+			return;
+		}
+		struct background_image *image = get_image(images, background);
+		if (!image) {
+			sway_log(L_ERROR, "Failed to read background image %s", background);
+			return;
+		}
+		render_background_image(window->cairo, image,
+				window->width * window->scale,
+				window->height * window->scale,
+				scaling_mode);
+	}
+
+	window_render(window);
+}
+
 int main(int argc, const char **argv) {
 	init_log(L_INFO);
 	surfaces = create_list();
 	registry = registry_poll();
 
-	if (argc != 4) {
+	// swaybg <output> <background> <mode> [<output> <background> <mode>...]
+	if (argc < 4 || (argc - 1) % 3 != 0) {
 		sway_abort("Do not run this program manually. See man 5 sway and look for output options.");
 	}
 
@@ -65,134 +111,36 @@ int main(int argc, const char **argv) {
 		sway_abort("swaybg requires the compositor to support the desktop-shell extension.");
 	}
 
-	int desired_output = atoi(argv[1]);
-	sway_log(L_INFO, "Using output %d of %d", desired_output, registry->outputs->length);
+	list_t *images = create_list();
 	int i;
-	struct output_state *output = registry->outputs->items[desired_output];
-	struct window *window = window_setup(registry,
-			output->width, output->height, output->scale, false);
-	if (!window) {
-		sway_abort("Failed to create surfaces.");
-	}
-	desktop_shell_set_background(registry->desktop_shell, output->output, window->surface);
-	window_make_shell(window);
-	list_add(surfaces, window);
-
-	if (strcmp(argv[3], "solid_color") == 0 && is_valid_color(argv[2])) {
-		cairo_set_source_u32(window->cairo, parse_color(argv[2]));
-		cairo_paint(window->cairo);
-		window_render(window);
-	} else {
-#ifdef WITH_GDK_PIXBUF
-		GError *err = NULL;
-		GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file(argv[2], &err);
-		if (!pixbuf) {
-			sway_abort("Failed to load background image.");
+	for (i = 1; i < argc; i += 3) {
+		int desired_output = atoi(argv[i]);
+		if (desired_output < 0 || desired_output >= registry->outputs->length) {
+			sway_log(L_ERROR, "Output %d does not exist", desired_output);
+			continue;
 		}
-		cairo_surface_t *image = gdk_cairo_image_surface_create_from_pixbuf(pixbuf);
-		g_object_unref(pixbuf);
-#else
-		cairo_surface_t *image = cairo_image_surface_create_from_png(argv[2]);
-#endif //WITH_GDK_PIXBUF
-		if (!image) {
-			sway_abort("Failed to read background image.");
-		}
-		double width = cairo_image_surface_get_width(image);
-		double height = cairo_image_surface_get_height(image);
-
-		const char *scaling_mode_str = argv[3];
-		enum scaling_mode scaling_mode = SCALING_MODE_STRETCH;
-		if (strcmp(scaling_mode_str, "stretch") == 0) {
-			scaling_mode = SCALING_MODE_STRETCH;
-		} else if (strcmp(scaling_mode_str, "fill") == 0) {
-			scaling_mode = SCALING_MODE_FILL;
-		} else if (strcmp(scaling_mode_str, "fit") == 0) {
-			scaling_mode = SCALING_MODE_FIT;
-		} else if (strcmp(scaling_mode_str, "center") == 0) {
-			scaling_mode = SCALING_MODE_CENTER;
-		} else if (strcmp(scaling_mode_str, "tile") == 0) {
-			scaling_mode = SCALING_MODE_TILE;
-		} else {
-			sway_abort("Unsupported scaling mode: %s", scaling_mode_str);
+		sway_log(L_INFO, "Using output %d of %d", desired_output, registry->outputs->length);
+		struct output_state *output = registry->outputs->items[desired_output];
+		struct window *window = window_setup(registry,
+				output->width, output->height, output->scale, false);
+		if (!window) {
+			sway_abort("Failed to create surfaces.");
 		}
+		desktop_shell_set_background(registry->desktop_shell, output->output, window->surface);
+		window_make_shell(window);
+		list_add(surfaces, window);
 
-		int wwidth = window->width * window->scale;
-		int wheight = window->height * window->scale;
-
-		for (i = 0; i < surfaces->length; ++i) {
-			struct window *window = surfaces->items[i];
-			if (window_prerender(window) && window->cairo) {
-				switch (scaling_mode) {
-				case SCALING_MODE_STRETCH:
-					cairo_scale(window->cairo,
-							(double) wwidth / width,
-							(double) wheight / height);
-					cairo_set_source_surface(window->cairo, image, 0, 0);
-					break;
-				case SCALING_MODE_FILL:
-				{
-					double window_ratio = (double) wwidth / wheight;
-					double bg_ratio = width / height;
-
-					if (window_ratio > bg_ratio) {
-						double scale = (double) wwidth / width;
-						cairo_scale(window->cairo, scale, scale);
-						cairo_set_source_surface(window->cairo, image,
-								0,
-								(double) wheight/2 / scale - height/2);
-					} else {
-						double scale = (double) wheight / height;
-						cairo_scale(window->cairo, scale, scale);
-						cairo_set_source_surface(window->cairo, image,
-								(double) wwidth/2 / scale - width/2,
-								0);
-					}
-					break;
-				}
-				case SCALING_MODE_FIT:
-				{
-					double window_ratio = (double) wwidth / wheight;
-					double bg_ratio = width / height;
-
-					if (window_ratio > bg_ratio) {
-						double scale = (double) wheight / height;
-						cairo_scale(window->cairo, scale, scale);
-						cairo_set_source_surface(window->cairo, image,
-								(double) wwidth/2 / scale - width/2,
-								0);
-					} else {
-						double scale = (double) wwidth / width;
-						cairo_scale(window->cairo, scale, scale);
-						cairo_set_source_surface(window->cairo, image,
-								0,
-								(double) wheight/2 / scale - height/2);
-					}
-					break;
-				}
-				case SCALING_MODE_CENTER:
-					cairo_set_source_surface(window->cairo, image,
-							(double) wwidth/2 - width/2,
-							(double) wheight/2 - height/2);
-					break;
-				case SCALING_MODE_TILE:
-				{
-					cairo_pattern_t *pattern = cairo_pattern_create_for_surface(image);
-					cairo_pattern_set_extend(pattern, CAIRO_EXTEND_REPEAT);
-					cairo_set_source(window->cairo, pattern);
-					break;
-				}
-				default:
-					sway_abort("Scaling mode '%s' not implemented yet!", scaling_mode_str);
-				}
-
-				cairo_paint(window->cairo);
-
-				window_render(window);
-			}
-		}
+		render_background(window, images, argv[i + 1], argv[i + 2]);
+	}
 
-		cairo_surface_destroy(image);
+	// The surfaces keep their buffers, the decoded and scaled images are no
+	// longer needed
+	for (i = 0; i < images->length; ++i) {
+		struct loaded_image *loaded = images->items[i];
+		free_background_image(loaded->image);
+		free(loaded);
 	}
+	list_free(images);
 
 	while (wl_display_dispatch(registry->display) != -1);
 
@@ -6,13 +6,18 @@
 #include <json-c/json.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/eventfd.h>
 #include <pwd.h>
 #include <getopt.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
 #include "client/window.h"
 #include "client/registry.h"
 #include "client/cairo.h"
@@ -26,21 +31,24 @@ struct render_data render_data;
 struct lock_config *config;
 bool show_indicator = true;
 
-void wl_dispatch_events() {
-	wl_display_flush(registry->display);
-	if (wl_display_dispatch(registry->display) == -1) {
-		sway_log(L_ERROR, "failed to run wl_display_dispatch");
-		exit(1);
-	}
-}
+// Interval at which the indicator is redrawn while PAM is busy
+#define VALIDATING_ANIMATION_MS 100
+
+// Authentication runs on a worker thread, so a slow PAM stack does not block
+// rendering. The worker signals completion through auth_fd.
+static pthread_t auth_thread;
+// false if the last attempt was verified without a worker thread
+static bool auth_threaded = false;
+static int auth_fd = -1;
+static bool auth_pending = false;
+static char *auth_password = NULL;
+static bool auth_success = false;
+
+static volatile sig_atomic_t hide_indicator = 0;
 
 void sigalarm_handler(int sig) {
-	signal(SIGALRM, SIG_IGN);
-	// Hide typing indicator
-	render_data.auth_state = AUTH_STATE_IDLE;
-	render(&render_data, config);
-	wl_display_flush(registry->display);
-	signal(SIGALRM, sigalarm_handler);
+	// Handled in the main loop, rendering is not async-signal-safe
+	hide_indicator = 1;
 }
 
 void sway_terminate(int exit_code) {
@@ -112,7 +120,8 @@ int function_conversation(int num_msg, const struct pam_message **msg,
 		switch (msg[i]->msg_style) {
 		case PAM_PROMPT_ECHO_OFF:
 		case PAM_PROMPT_ECHO_ON:
-			pam_reply[i].resp = password;
+			// PAM frees the responses
+			pam_reply[i].resp = strdup(appdata_ptr);
 			break;
 
 		case PAM_ERROR_MSG:
@@ -124,47 +133,89 @@ int function_conversation(int num_msg, const struct pam_message **msg,
 	return PAM_SUCCESS;
 }
 
-/**
- * Note: PAM will free() 'password' during the process
- */
-bool verify_password() {
+bool verify_password(char *password) {
 	struct passwd *passwd = getpwuid(getuid());
 	char *username = passwd->pw_name;
 
-	const struct pam_conv local_conversation = { function_conversation, NULL };
+	const struct pam_conv local_conversation = { function_conversation, password };
 	pam_handle_t *local_auth_handle = NULL;
 	int pam_err;
 	if ((pam_err = pam_start("swaylock", username, &local_conversation, &local_auth_handle)) != PAM_SUCCESS) {
 		sway_abort("PAM returned %d\n", pam_err);
 	}
-	if ((pam_err = pam_authenticate(local_auth_handle, 0)) != PAM_SUCCESS) {
-		return false;
-	}
+	bool success = (pam_err = pam_authenticate(local_auth_handle, 0)) == PAM_SUCCESS;
 	if ((pam_err = pam_end(local_auth_handle, pam_err)) != PAM_SUCCESS) {
 		return false;
 	}
-	return true;
+	return success;
+}
+
+static void *auth_worker(void *data) {
+	auth_success = verify_password(auth_password);
+	uint64_t done = 1;
+	if (write(auth_fd, &done, sizeof(done)) != sizeof(done)) {
+		sway_log(L_ERROR, "Unable to signal authentication result");
+	}
+	return NULL;
+}
+
+/**
+ * Starts verifying the given password on the worker thread, which takes
+ * ownership of it.
+ */
+static void start_auth(char *password) {
+	auth_password = password;
+	auth_pending = true;
+	auth_threaded = pthread_create(&auth_thread, NULL, auth_worker, NULL) == 0;
+	if (!auth_threaded) {
+		sway_log(L_ERROR, "Unable to start authentication thread, verifying synchronously");
+		auth_worker(NULL);
+	}
+}
+
+static void finish_auth(void) {
+	uint64_t done;
+	if (read(auth_fd, &done, sizeof(done)) != sizeof(done)) {
+		return;
+	}
+	if (auth_threaded) {
+		pthread_join(auth_thread, NULL);
+		auth_threaded = false;
+	}
+	auth_pending = false;
+
+	memset(auth_password, 0, strlen(auth_password));
+	free(auth_password);
+	auth_password = NULL;
+
+	if (auth_success) {
+		exit(0);
+	}
+	render_data.auth_state = AUTH_STATE_INVALID;
+	render(&render_data, config);
+	// Hide the indicator after a couple of seconds
+	alarm(5);
 }
 
 void notify_key(enum wl_keyboard_key_state state, xkb_keysym_t sym, uint32_t code, uint32_t codepoint) {
 	int redraw_screen = 0;
 	char *password_realloc;
 
+	if (auth_pending) {
+		// Like i3lock, ignore input until the current attempt is verified
+		return;
+	}
+
 	if (state == WL_KEYBOARD_KEY_STATE_PRESSED) {
 		switch (sym) {
 		case XKB_KEY_KP_Enter: // fallthrough
 		case XKB_KEY_Return:
 			render_data.auth_state = AUTH_STATE_VALIDATING;
-
 			render(&render_data, config);
-			// Make sure our render call will actually be displayed on the screen
-			wl_dispatch_events();
+			wl_display_flush(registry->display);
+			alarm(0);
 
-			if (verify_password()) {
-				exit(0);
-			}
-			render_data.auth_state = AUTH_STATE_INVALID;
-			redraw_screen = 1;
+			start_auth(password);
 
 			password_size = 1024;
 			password = malloc(password_size);
@@ -241,106 +292,23 @@ void notify_key(enum wl_keyboard_key_state state, xkb_keysym_t sym, uint32_t cod
 		}
 		if (redraw_screen) {
 			render(&render_data, config);
-			wl_dispatch_events();
+			wl_display_flush(registry->display);
 			// Hide the indicator after a couple of seconds
 			alarm(5);
 		}
 	}
 }
 
-void render_color(struct window *window, uint32_t color) {
-	cairo_set_source_u32(window->cairo, color);
-	cairo_paint(window->cairo);
-}
-
-void render_image(struct window *window, cairo_surface_t *image, enum scaling_mode scaling_mode) {
-	double width = cairo_image_surface_get_width(image);
-	double height = cairo_image_surface_get_height(image);
-	int wwidth = window->width * window->scale;
-	int wheight = window->height * window->scale;
-
-	switch (scaling_mode) {
-	case SCALING_MODE_STRETCH:
-		cairo_scale(window->cairo,
-				(double) wwidth / width,
-				(double) wheight / height);
-		cairo_set_source_surface(window->cairo, image, 0, 0);
-		break;
-	case SCALING_MODE_FILL:
-	{
-		double window_ratio = (double) wwidth / wheight;
-		double bg_ratio = width / height;
-
-		if (window_ratio > bg_ratio) {
-			double scale = (double) wwidth / width;
-			cairo_scale(window->cairo, scale, scale);
-			cairo_set_source_surface(window->cairo, image,
-					0,
-					(double) wheight/2 / scale - height/2);
-		} else {
-			double scale = (double) wheight / height;
-			cairo_scale(window->cairo, scale, scale);
-			cairo_set_source_surface(window->cairo, image,
-					(double) wwidth/2 / scale - width/2,
-					0);
-		}
-		break;
-	}
-	case SCALING_MODE_FIT:
-	{
-		double window_ratio = (double) wwidth / wheight;
-		double bg_ratio = width / height;
-
-		if (window_ratio > bg_ratio) {
-			double scale = (double) wheight / height;
-			cairo_scale(window->cairo, scale, scale);
-			cairo_set_source_surface(window->cairo, image,
-					(double) wwidth/2 / scale - width/2,
-					0);
-		} else {
-			double scale = (double) wwidth / width;
-			cairo_scale(window->cairo, scale, scale);
-			cairo_set_source_surface(window->cairo, image,
-					0,
-					(double) wheight/2 / scale - height/2);
-		}
-		break;
-	}
-	case SCALING_MODE_CENTER:
-		cairo_set_source_surface(window->cairo, image,
-				(double) wwidth/2 - width/2,
-				(double) wheight/2 - height/2);
-		break;
-	case SCALING_MODE_TILE:
-	{
-		cairo_pattern_t *pattern = cairo_pattern_create_for_surface(image);
-		cairo_pattern_set_extend(pattern, CAIRO_EXTEND_REPEAT);
-		cairo_set_source(window->cairo, pattern);
-		break;
-	}
-	}
-
-	cairo_paint(window->cairo);
+void render_color(cairo_t *cairo, uint32_t color) {
+	cairo_set_source_u32(cairo, color);
+	cairo_paint(cairo);
 }
 
-cairo_surface_t *load_image(char *image_path) {
-	cairo_surface_t *image = NULL;
-
-#ifdef WITH_GDK_PIXBUF
-	GError *err = NULL;
-	GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file(image_path, &err);
-	if (!pixbuf) {
-		sway_abort("Failed to load background image: %s", err->message);
-	}
-	image = gdk_cairo_image_surface_create_from_pixbuf(pixbuf);
-	g_object_unref(pixbuf);
-#else
-	image = cairo_image_surface_create_from_png(image_path);
-#endif //WITH_GDK_PIXBUF
+struct background_image *load_image(char *image_path) {
+	struct background_image *image = load_background_image(image_path);
 	if (!image) {
 		sway_abort("Failed to read background image.");
 	}
-
 	return image;
 }
 
@@ -517,18 +485,7 @@ int main(int argc, char **argv) {
 		}
 	}
 
-	render_data.scaling_mode = SCALING_MODE_STRETCH;
-	if (strcmp(scaling_mode_str, "stretch") == 0) {
-		render_data.scaling_mode = SCALING_MODE_STRETCH;
-	} else if (strcmp(scaling_mode_str, "fill") == 0) {
-		render_data.scaling_mode = SCALING_MODE_FILL;
-	} else if (strcmp(scaling_mode_str, "fit") == 0) {
-		render_data.scaling_mode = SCALING_MODE_FIT;
-	} else if (strcmp(scaling_mode_str, "center") == 0) {
-		render_data.scaling_mode = SCALING_MODE_CENTER;
-	} else if (strcmp(scaling_mode_str, "tile") == 0) {
-		render_data.scaling_mode = SCALING_MODE_TILE;
-	} else {
+	if (!parse_scaling_mode(scaling_mode_str, &render_data.scaling_mode)) {
 		sway_abort("Unsupported scaling mode: %s", scaling_mode_str);
 	}
 
@@ -568,11 +525,12 @@ int main(int argc, char **argv) {
 	}
 
 	registry->input->notify = notify_key;
+	render_data.backgrounds = calloc(render_data.surfaces->length, sizeof(cairo_surface_t *));
 
 	// Different background for the output
 	if (render_data.num_images >= 1) {
 		char **displays_paths = images;
-		render_data.images = calloc(registry->outputs->length, sizeof(cairo_surface_t*));
+		render_data.images = calloc(registry->outputs->length, sizeof(struct background_image *));
 
 		int socketfd = ipc_open_socket(socket_path);
 		uint32_t len = 0;
@@ -604,27 +562,67 @@ int main(int argc, char **argv) {
 		free(displays_paths);
 	}
 
+	auth_fd = eventfd(0, EFD_CLOEXEC);
+	if (auth_fd == -1) {
+		sway_abort("Unable to create eventfd for authentication");
+	}
+
+	struct pollfd pfd[2];
+	pfd[0].fd = wl_display_get_fd(registry->display);
+	pfd[0].events = POLLIN;
+	pfd[1].fd = auth_fd;
+	pfd[1].events = POLLIN;
+
 	render(&render_data, config);
 	bool locked = false;
-	while (wl_display_dispatch(registry->display) != -1) {
-		if (!locked) {
-			for (i = 0; i < registry->outputs->length; ++i) {
-				struct output_state *output = registry->outputs->items[i];
-				struct window *window = render_data.surfaces->items[i];
-				lock_set_lock_surface(registry->swaylock, output->output, window->surface);
+	while (1) {
+		wl_display_flush(registry->display);
+		int timeout = auth_pending ? VALIDATING_ANIMATION_MS : -1;
+		int ret = poll(pfd, 2, timeout);
+		if (ret == -1 && errno != EINTR) {
+			sway_log(L_ERROR, "poll failed: %d", errno);
+			break;
+		}
+
+		if (ret > 0 && pfd[0].revents & POLLIN) {
+			if (wl_display_dispatch(registry->display) == -1) {
+				break;
+			}
+			if (!locked) {
+				for (i = 0; i < registry->outputs->length; ++i) {
+					struct output_state *output = registry->outputs->items[i];
+					struct window *window = render_data.surfaces->items[i];
+					lock_set_lock_surface(registry->swaylock, output->output, window->surface);
+				}
+				locked = true;
+			}
+		} else {
+			wl_display_dispatch_pending(registry->display);
+		}
+
+		if (ret > 0 && pfd[1].revents & POLLIN) {
+			finish_auth();
+		} else if (auth_pending) {
+			// Keep the validating indicator moving
+			render(&render_data, config);
+		}
+
+		if (hide_indicator) {
+			hide_indicator = 0;
+			if (!auth_pending) {
+				render_data.auth_state = AUTH_STATE_IDLE;
+				render(&render_data, config);
 			}
-			locked = true;
 		}
 	}
+	close(auth_fd);
 
 	// Free surfaces
 	if (render_data.num_images == -1) {
-		cairo_surface_destroy(render_data.image);
+		free_background_image(render_data.image);
 	} else if (render_data.num_images >= 1) {
 		for (i = 0; i < registry->outputs->length; ++i) {
-			if (render_data.images[i] != NULL) {
-				cairo_surface_destroy(render_data.images[i]);
-			}
+			free_background_image(render_data.images[i]);
 		}
 		free(render_data.images);
 	}
@@ -632,7 +630,11 @@ int main(int argc, char **argv) {
 	for (i = 0; i < render_data.surfaces->length; ++i) {
 		struct window *window = render_data.surfaces->items[i];
 		window_teardown(window);
+		if (render_data.backgrounds[i]) {
+			cairo_surface_destroy(render_data.backgrounds[i]);
+		}
 	}
+	free(render_data.backgrounds);
 	list_free(render_data.surfaces);
 	registry_teardown(registry);
 
@@ -641,7 +643,54 @@ int main(int argc, char **argv) {
 	return 0;
 }
 
+/**
+ * Returns the background of the given surface, which is painted once and then
+ * reused for every redraw of the indicator.
+ */
+static cairo_surface_t *get_background(struct render_data *render_data,
+		int i, int wwidth, int wheight) {
+	cairo_surface_t *background = render_data->backgrounds[i];
+	if (background && cairo_image_surface_get_width(background) == wwidth
+			&& cairo_image_surface_get_height(background) == wheight) {
+		return background;
+	}
+	if (background) {
+		cairo_surface_destroy(background);
+	}
+
+	background = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, wwidth, wheight);
+	cairo_t *cairo = cairo_create(background);
+	if (render_data->num_images == 0 || render_data->color_set) {
+		render_color(cairo, render_data->color);
+	}
+
+	if (render_data->num_images == -1) {
+		// One background for all
+		render_background_image(cairo, render_data->image,
+				wwidth, wheight, render_data->scaling_mode);
+	} else if (render_data->num_images >= 1) {
+		// Different backgrounds
+		if (render_data->images[i] != NULL) {
+			render_background_image(cairo, render_data->images[i],
+					wwidth, wheight, render_data->scaling_mode);
+		}
+	}
+	cairo_destroy(cairo);
+	cairo_surface_flush(background);
+
+	render_data->backgrounds[i] = background;
+	return background;
+}
+
 void render(struct render_data *render_data, struct lock_config *config) {
+	// Draw specific values (copied from i3)
+	const int ARC_RADIUS = 50;
+	const int ARC_THICKNESS = 10;
+	const float TYPE_INDICATOR_RANGE = M_PI / 3.0f;
+	const float TYPE_INDICATOR_BORDER_THICKNESS = M_PI / 128.0f;
+	// Half the size of the box that contains everything the indicator draws
+	const int INDICATOR_EXTENT = ARC_RADIUS + ARC_THICKNESS;
+
 	int i;
 	for (i = 0; i < render_data->surfaces->length; ++i) {
 		sway_log(L_DEBUG, "Render surface %d of %d", i, render_data->surfaces->length);
@@ -652,36 +701,26 @@ void render(struct render_data *render_data, struct lock_config *config) {
 		int wwidth = window->width * window->scale;
 		int wheight = window->height * window->scale;
 
-		cairo_save(window->cairo);
-		cairo_set_operator(window->cairo, CAIRO_OPERATOR_CLEAR);
-		cairo_paint(window->cairo);
-		cairo_restore(window->cairo);
-
 		// Reset the transformation matrix
 		cairo_identity_matrix(window->cairo);
 
-		if (render_data->num_images == 0 || render_data->color_set) {
-			render_color(window, render_data->color);
-		}
+		// Only the indicator changes after the first frame, so a buffer that
+		// has been painted before just needs the indicator area restored
+		cairo_surface_t *background = get_background(render_data, i, wwidth, wheight);
+		bool full_redraw = window->buffer->blank;
+		int box_x = wwidth/2 - INDICATOR_EXTENT, box_y = wheight/2 - INDICATOR_EXTENT;
+		int box_size = INDICATOR_EXTENT * 2;
 
-		if (render_data->num_images == -1) {
-			// One background for all
-			render_image(window, render_data->image, render_data->scaling_mode);
-		} else if (render_data->num_images >= 1) {
-			// Different backgrounds
-			if (render_data->images[i] != NULL) {
-				render_image(window, render_data->images[i], render_data->scaling_mode);
-			}
+		cairo_save(window->cairo);
+		if (!full_redraw) {
+			cairo_rectangle(window->cairo, box_x, box_y, box_size, box_size);
+			cairo_clip(window->cairo);
 		}
-
-		// Reset the transformation matrix again
-		cairo_identity_matrix(window->cairo);
-
-		// Draw specific values (copied from i3)
-		const int ARC_RADIUS = 50;
-		const int ARC_THICKNESS = 10;
-		const float TYPE_INDICATOR_RANGE = M_PI / 3.0f;
-		const float TYPE_INDICATOR_BORDER_THICKNESS = M_PI / 128.0f;
+		cairo_set_operator(window->cairo, CAIRO_OPERATOR_SOURCE);
+		cairo_set_source_surface(window->cairo, background, 0, 0);
+		cairo_paint(window->cairo);
+		cairo_restore(window->cairo);
+		window->buffer->blank = false;
 
 		// Add visual indicator
 		if (show_indicator && render_data->auth_state != AUTH_STATE_IDLE) {
@@ -741,8 +780,17 @@ void render(struct render_data *render_data, struct lock_config *config) {
 			}
 
 			// Typing indicator: Highlight random part on keypress
+			static double highlight_start = 0;
+			if (render_data->auth_state == AUTH_STATE_VALIDATING) {
+				// Spin while PAM is verifying the password
+				if (i == 0) {
+					highlight_start += M_PI / 8;
+				}
+				cairo_arc(window->cairo, wwidth/2, wheight/2, ARC_RADIUS, highlight_start, highlight_start + TYPE_INDICATOR_RANGE);
+				cairo_set_source_u32(window->cairo, config->colors.validating.inner_ring);
+				cairo_stroke(window->cairo);
+			}
 			if (render_data->auth_state == AUTH_STATE_INPUT || render_data->auth_state == AUTH_STATE_BACKSPACE) {
-				static double highlight_start = 0;
 				highlight_start += (rand() % (int)(M_PI * 100)) / 100.0 + M_PI * 0.5;
 				cairo_arc(window->cairo, wwidth/2, wheight/2, ARC_RADIUS, highlight_start, highlight_start + TYPE_INDICATOR_RANGE);
 				if (render_data->auth_state == AUTH_STATE_INPUT) {
@@ -798,6 +846,14 @@ void render(struct render_data *render_data, struct lock_config *config) {
 			cairo_arc(window->cairo, wwidth/2, wheight/2, ARC_RADIUS + ARC_THICKNESS/2, 0, 2*M_PI);
 			cairo_stroke(window->cairo);
 		}
-		window_render(window);
+
+		if (full_redraw) {
+			window_render(window);
+		} else {
+			// Damage is in surface coordinates, round outwards
+			int scale = window->scale;
+			window_render_region(window, box_x / scale, box_y / scale,
+					box_size / scale + 2, box_size / scale + 2);
+		}
 	}
 }
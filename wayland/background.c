@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <string.h>
+#include <cairo/cairo.h>
+#include "client/background.h"
+#include "client/cairo.h"
+#include "list.h"
+#include "log.h"
+
+bool parse_scaling_mode(const char *name, enum scaling_mode *mode) {
+	if (strcmp(name, "stretch") == 0) {
+		*mode = SCALING_MODE_STRETCH;
+	} else if (strcmp(name, "fill") == 0) {
+		*mode = SCALING_MODE_FILL;
+	} else if (strcmp(name, "fit") == 0) {
+		*mode = SCALING_MODE_FIT;
+	} else if (strcmp(name, "center") == 0) {
+		*mode = SCALING_MODE_CENTER;
+	} else if (strcmp(name, "tile") == 0) {
+		*mode = SCALING_MODE_TILE;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+struct background_image *load_background_image(const char *path) {
+	cairo_surface_t *image = NULL;
+
+#ifdef WITH_GDK_PIXBUF
+	GError *err = NULL;
+	GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file(path, &err);
+	if (!pixbuf) {
+		sway_log(L_ERROR, "Failed to load background image: %s", err->message);
+		return NULL;
+	}
+	image = gdk_cairo_image_surface_create_from_pixbuf(pixbuf);
+	g_object_unref(pixbuf);
+#else
+	image = cairo_image_surface_create_from_png(path);
+#endif //WITH_GDK_PIXBUF
+	if (!image || cairo_surface_status(image) != CAIRO_STATUS_SUCCESS) {
+		sway_log(L_ERROR, "Failed to read background image %s", path);
+		if (image) {
+			cairo_surface_destroy(image);
+		}
+		return NULL;
+	}
+
+	struct background_image *background = calloc(1, sizeof(struct background_image));
+	background->image = image;
+	background->scaled = create_list();
+	return background;
+}
+
+void free_background_image(struct background_image *image) {
+	if (!image) {
+		return;
+	}
+	int i;
+	for (i = 0; i < image->scaled->length; ++i) {
+		struct scaled_image *scaled = image->scaled->items[i];
+		cairo_surface_destroy(scaled->surface);
+		free(scaled);
+	}
+	list_free(image->scaled);
+	cairo_surface_destroy(image->image);
+	free(image);
+}
+
+static void scale_image(cairo_t *cairo, cairo_surface_t *image,
+		int wwidth, int wheight, enum scaling_mode scaling_mode) {
+	double width = cairo_image_surface_get_width(image);
+	double height = cairo_image_surface_get_height(image);
+
+	switch (scaling_mode) {
+	case SCALING_MODE_STRETCH:
+		cairo_scale(cairo,
+				(double) wwidth / width,
+				(double) wheight / height);
+		cairo_set_source_surface(cairo, image, 0, 0);
+		break;
+	case SCALING_MODE_FILL:
+	{
+		double window_ratio = (double) wwidth / wheight;
+		double bg_ratio = width / height;
+
+		if (window_ratio > bg_ratio) {
+			double scale = (double) wwidth / width;
+			cairo_scale(cairo, scale, scale);
+			cairo_set_source_surface(cairo, image,
+					0,
+					(double) wheight/2 / scale - height/2);
+		} else {
+			double scale = (double) wheight / height;
+			cairo_scale(cairo, scale, scale);
+			cairo_set_source_surface(cairo, image,
+					(double) wwidth/2 / scale - width/2,
+					0);
+		}
+		break;
+	}
+	case SCALING_MODE_FIT:
+	{
+		double window_ratio = (double) wwidth / wheight;
+		double bg_ratio = width / height;
+
+		if (window_ratio > bg_ratio) {
+			double scale = (double) wheight / height;
+			cairo_scale(cairo, scale, scale);
+			cairo_set_source_surface(cairo, image,
+					(double) wwidth/2 / scale - width/2,
+					0);
+		} else {
+			double scale = (double) wwidth / width;
+			cairo_scale(cairo, scale, scale);
+			cairo_set_source_surface(cairo, image,
+					0,
+					(double) wheight/2 / scale - height/2);
+		}
+		break;
+	}
+	case SCALING_MODE_CENTER:
+		cairo_set_source_surface(cairo, image,
+				(double) wwidth/2 - width/2,
+				(double) wheight/2 - height/2);
+		break;
+	case SCALING_MODE_TILE:
+	{
+		cairo_pattern_t *pattern = cairo_pattern_create_for_surface(image);
+		cairo_pattern_set_extend(pattern, CAIRO_EXTEND_REPEAT);
+		cairo_set_source(cairo, pattern);
+		cairo_pattern_destroy(pattern);
+		break;
+	}
+	}
+
+	cairo_paint(cairo);
+}
+
+cairo_surface_t *get_scaled_image(struct background_image *image,
+		int width, int height, enum scaling_mode mode) {
+	int i;
+	for (i = 0; i < image->scaled->length; ++i) {
+		struct scaled_image *scaled = image->scaled->items[i];
+		if (scaled->width == width && scaled->height == height
+				&& scaled->mode == mode) {
+			return scaled->surface;
+		}
+	}
+
+	sway_log(L_DEBUG, "Scaling background image to %dx%d", width, height);
+	cairo_surface_t *surface = cairo_image_surface_create(
+			CAIRO_FORMAT_ARGB32, width, height);
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+		sway_log(L_ERROR, "Unable to allocate %dx%d background surface", width, height);
+		cairo_surface_destroy(surface);
+		return NULL;
+	}
+	cairo_t *cairo = cairo_create(surface);
+	scale_image(cairo, image->image, width, height, mode);
+	cairo_destroy(cairo);
+	cairo_surface_flush(surface);
+
+	struct scaled_image *scaled = malloc(sizeof(struct scaled_image));
+	scaled->width = width;
+	scaled->height = height;
+	scaled->mode = mode;
+	scaled->surface = surface;
+	list_add(image->scaled, scaled);
+	return surface;
+}
+
+void render_background_image(cairo_t *cairo, struct background_image *image,
+		int width, int height, enum scaling_mode mode) {
+	cairo_surface_t *scaled = get_scaled_image(image, width, height, mode);
+	if (!scaled) {
+		return;
+	}
+	cairo_save(cairo);
+	cairo_identity_matrix(cairo);
+	cairo_set_source_surface(cairo, scaled, 0, 0);
+	cairo_paint(cairo);
+	cairo_restore(cairo);
+}
@@ -1,4 +1,4 @@
-#define _XOPEN_SOURCE 500
+#define _GNU_SOURCE
 #include <wayland-client.h>
 #include <cairo/cairo.h>
 #include <pango/pangocairo.h>
@@ -7,11 +7,19 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #include "client/buffer.h"
 #include "list.h"
 #include "log.h"
 
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
 static int create_pool_file(size_t size, char **name) {
 	static const char template[] = "sway-client-XXXXXX";
 	const char *path = getenv("XDG_RUNTIME_DIR");
@@ -41,6 +49,34 @@ static int create_pool_file(size_t size, char **name) {
 	return fd;
 }
 
+/**
+ * Creates an anonymous shared memory file. memfd never touches the
+ * filesystem; XDG_RUNTIME_DIR is only used on kernels without it.
+ */
+static int create_pool_fd(size_t size) {
+	int fd = -1;
+#if defined(__linux__) && defined(SYS_memfd_create)
+	fd = syscall(SYS_memfd_create, "sway-client", MFD_CLOEXEC);
+	if (fd >= 0) {
+		if (ftruncate(fd, size) < 0) {
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+#endif
+	char *name = NULL;
+	fd = create_pool_file(size, &name);
+	if (name) {
+		unlink(name);
+		free(name);
+	}
+	if (fd >= 0) {
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+	}
+	return fd;
+}
+
 static void buffer_release(void *data, struct wl_buffer *wl_buffer) {
 	struct buffer *buffer = data;
 	buffer->busy = false;
@@ -50,33 +86,89 @@ static const struct wl_buffer_listener buffer_listener = {
 	.release = buffer_release
 };
 
+/**
+ * Drops the wl_buffer and cairo state but keeps the mapping, so the memory can
+ * back a buffer of a different size later on.
+ */
+static void release_buffer_surface(struct buffer *buffer) {
+	if (buffer->buffer) {
+		wl_buffer_destroy(buffer->buffer);
+		buffer->buffer = NULL;
+	}
+	if (buffer->cairo) {
+		cairo_destroy(buffer->cairo);
+		buffer->cairo = NULL;
+	}
+	if (buffer->surface) {
+		cairo_surface_destroy(buffer->surface);
+		buffer->surface = NULL;
+	}
+	if (buffer->pango) {
+		g_object_unref(buffer->pango);
+		buffer->pango = NULL;
+	}
+	buffer->width = buffer->height = 0;
+}
+
+static void destroy_buffer(struct buffer *buffer) {
+	release_buffer_surface(buffer);
+	if (buffer->pool) {
+		wl_shm_pool_destroy(buffer->pool);
+	}
+	if (buffer->data) {
+		munmap(buffer->data, buffer->size);
+	}
+	memset(buffer, 0, sizeof(struct buffer));
+}
+
+static bool map_buffer(struct window *window, struct buffer *buf, size_t size) {
+	int fd = create_pool_fd(size);
+	if (fd == -1) {
+		return false;
+	}
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+	buf->pool = wl_shm_create_pool(window->registry->shm, fd, size);
+	close(fd);
+	buf->data = data;
+	buf->size = size;
+	window->pool.allocations++;
+	sway_log(L_DEBUG, "Mapped %zu byte buffer (allocations: %u, reuses: %u, starved frames: %u)",
+			size, window->pool.allocations, window->pool.reuses, window->pool.starved);
+	return true;
+}
+
 static struct buffer *create_buffer(struct window *window, struct buffer *buf,
 		int32_t width, int32_t height, int32_t scale, uint32_t format) {
 
 	width *= scale;
 	height *= scale;
 	uint32_t stride = width * 4;
-	uint32_t size = stride * height;
+	size_t size = (size_t)stride * height;
 
-	char *name;
-	int fd = create_pool_file(size, &name);
-	if (fd == -1) {
-		sway_abort("Unable to allocate buffer");
-		return NULL; // never reached
+	release_buffer_surface(buf);
+	if (buf->data && buf->size >= size) {
+		window->pool.reuses++;
+	} else {
+		if (buf->data) {
+			destroy_buffer(buf);
+		}
+		if (!map_buffer(window, buf, size)) {
+			sway_abort("Unable to allocate buffer");
+			return NULL; // never reached
+		}
 	}
-	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-	struct wl_shm_pool *pool = wl_shm_create_pool(window->registry->shm, fd, size);
-	buf->buffer = wl_shm_pool_create_buffer(pool, 0,
+
+	buf->buffer = wl_shm_pool_create_buffer(buf->pool, 0,
 			width, height, stride, format);
-	wl_shm_pool_destroy(pool);
-	close(fd);
-	unlink(name);
-	free(name);
-	fd = -1;
 
 	buf->width = width;
 	buf->height = height;
-	buf->surface = cairo_image_surface_create_for_data(data,
+	buf->blank = true;
+	buf->surface = cairo_image_surface_create_for_data(buf->data,
 			CAIRO_FORMAT_ARGB32, width, height, stride);
 	buf->cairo = cairo_create(buf->surface);
 	buf->pango = pango_cairo_create_context(buf->cairo);
@@ -85,42 +177,79 @@ static struct buffer *create_buffer(struct window *window, struct buffer *buf,
 	return buf;
 }
 
-static void destroy_buffer(struct buffer *buffer) {
-	if (buffer->buffer) {
-		wl_buffer_destroy(buffer->buffer);
+static struct buffer *find_free_buffer(struct buffer_pool *pool,
+		uint32_t width, uint32_t height) {
+	struct buffer *match = NULL, *fallback = NULL;
+	size_t size = (size_t)width * height * 4;
+	int i;
+	for (i = 0; i < pool->count; ++i) {
+		struct buffer *buffer = &pool->buffers[i];
+		if (buffer->busy) {
+			continue;
+		}
+		if (buffer->buffer && buffer->width == width && buffer->height == height) {
+			match = buffer;
+		} else if (!fallback || (buffer->size >= size && fallback->size < size)) {
+			fallback = buffer;
+		}
 	}
-	if (buffer->cairo) {
-		cairo_destroy(buffer->cairo);
+	return match ? match : fallback;
+}
+
+/**
+ * Gives the last buffer of a grown pool back once the compositor stopped
+ * holding on to that many buffers for a while.
+ */
+static void shrink_buffer_pool(struct window *window) {
+	struct buffer_pool *pool = &window->pool;
+	if (pool->count <= BUFFER_POOL_MIN) {
+		pool->idle = 0;
+		return;
 	}
-	if (buffer->surface) {
-		cairo_surface_destroy(buffer->surface);
+	int free_buffers = 0;
+	int i;
+	for (i = 0; i < pool->count; ++i) {
+		if (!pool->buffers[i].busy) {
+			++free_buffers;
+		}
 	}
-	if (buffer->pango) {
-		g_object_unref(buffer->pango);
+	if (free_buffers < 2) {
+		pool->idle = 0;
+		return;
 	}
-	memset(buffer, 0, sizeof(struct buffer));
+	struct buffer *last = &pool->buffers[pool->count - 1];
+	if (++pool->idle < BUFFER_POOL_SHRINK_FRAMES || last->busy || last == window->buffer) {
+		return;
+	}
+	destroy_buffer(last);
+	pool->count--;
+	pool->idle = 0;
+	sway_log(L_DEBUG, "Shrinking buffer pool to %d buffers", pool->count);
 }
 
 struct buffer *get_next_buffer(struct window *window) {
-	struct buffer *buffer = NULL;
+	struct buffer_pool *pool = &window->pool;
+	uint32_t width = window->width * window->scale;
+	uint32_t height = window->height * window->scale;
 
-	int i;
-	for (i = 0; i < 2; ++i) {
-		if (window->buffers[i].busy) {
-			continue;
-		}
-		buffer = &window->buffers[i];
-	}
+	shrink_buffer_pool(window);
 
+	struct buffer *buffer = find_free_buffer(pool, width, height);
 	if (!buffer) {
-		return NULL;
-	}
-
-	if (buffer->width != window->width || buffer->height != window->height) {
-		destroy_buffer(buffer);
+		// Every buffer is held by the compositor, grow the pool if allowed
+		if (pool->count == BUFFER_POOL_MAX) {
+			pool->starved++;
+			sway_log(L_DEBUG, "All %d buffers busy (starved frames: %u)",
+					pool->count, pool->starved);
+			return NULL;
+		}
+		buffer = &pool->buffers[pool->count++];
+		if (pool->count > BUFFER_POOL_MIN) {
+			sway_log(L_DEBUG, "Growing buffer pool to %d buffers", pool->count);
+		}
 	}
 
-	if (!buffer->buffer) {
+	if (!buffer->buffer || buffer->width != width || buffer->height != height) {
 		if (!create_buffer(window, buffer,
 					window->width, window->height, window->scale,
 					WL_SHM_FORMAT_ARGB8888)) {
@@ -132,3 +261,16 @@ struct buffer *get_next_buffer(struct window *window) {
 	window->buffer = buffer;
 	return buffer;
 }
+
+void destroy_buffer_pool(struct window *window) {
+	struct buffer_pool *pool = &window->pool;
+	sway_log(L_DEBUG, "Buffer pool of %d: %u allocations, %u reuses, %u starved frames",
+			pool->count, pool->allocations, pool->reuses, pool->starved);
+	int i;
+	for (i = 0; i < pool->count; ++i) {
+		destroy_buffer(&pool->buffers[i]);
+	}
+	pool->count = 0;
+	window->buffer = NULL;
+	window->cairo = NULL;
+}
@@ -156,22 +156,54 @@ int window_prerender(struct window *window) {
 		return 0;
 	}
 
-	get_next_buffer(window);
+	if (!get_next_buffer(window)) {
+		return 0;
+	}
 	return 1;
 }
 
 int window_render(struct window *window) {
+	return window_render_region(window, 0, 0, window->width, window->height);
+}
+
+int window_render_region(struct window *window, int x, int y, int width, int height) {
 	window->frame_cb = wl_surface_frame(window->surface);
 	wl_callback_add_listener(window->frame_cb, &listener, window);
 
 	wl_surface_attach(window->surface, window->buffer->buffer, 0, 0);
+	// Held by the compositor until it sends a release
+	window->buffer->busy = true;
 	wl_surface_set_buffer_scale(window->surface, window->scale);
-	wl_surface_damage(window->surface, 0, 0, window->width, window->height);
+	wl_surface_damage(window->surface, x, y, width, height);
 	wl_surface_commit(window->surface);
 
 	return 1;
 }
 
 void window_teardown(struct window *window) {
-	// TODO
+	if (!window) {
+		return;
+	}
+	if (window->frame_cb) {
+		wl_callback_destroy(window->frame_cb);
+		window->frame_cb = NULL;
+	}
+	destroy_buffer_pool(window);
+	if (window->cursor.surface) {
+		wl_surface_destroy(window->cursor.surface);
+		window->cursor.surface = NULL;
+	}
+	if (window->cursor.cursor_theme) {
+		wl_cursor_theme_destroy(window->cursor.cursor_theme);
+		window->cursor.cursor_theme = NULL;
+		window->cursor.cursor = NULL;
+	}
+	if (window->shell_surface) {
+		wl_shell_surface_destroy(window->shell_surface);
+		window->shell_surface = NULL;
+	}
+	if (window->surface) {
+		wl_surface_destroy(window->surface);
+		window->surface = NULL;
+	}
 }